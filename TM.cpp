@@ -3,14 +3,30 @@
 
 #include "tm.h"
 #include "shadow_map.h"
-
+#include "lighting.h"
+#include "mesh_bake.h"
+#include "profiler.h"
+#include "trace.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <cfloat>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 
 using namespace std;
 
+// Shared across all meshes so the largest version in a set of meshes changes whenever any of them does.
+// Atomic because meshes are loaded on worker threads, see AssetLoader
+static atomic<unsigned int> next_geometry_version(1);
+
 TM::TM(char* fname) : TM() {
-	load_bin(fname);
+	size_t len = strlen(fname);
+	if (len > 4 && strcmp(fname + len - 4, ".gpm") == 0)
+		load_mesh_file(fname);
+	else
+		load_bin(fname);
 }
 
 TM::TM(V3 center, float radius, float height, int _num_verts, unsigned int color) : TM() {
@@ -76,37 +92,35 @@ TM::TM(V3 center, float radius, float height, int _num_verts, unsigned int color
 		tris[(ti + 3 * tris_per_circle) * 3 + 1] = ((ti + 1) % (num_verts / 2 - 1)) + num_verts / 2;
 		tris[(ti + 3 * tris_per_circle) * 3 + 2] = ti + num_verts / 2;
 	}
+	mark_geometry_changed();
 }
 
 TM::TM(V3 p1, V3 p2, unsigned int color) : TM(){
 	set_as_plane(p1, p2, color);
 }
 
-void TM::set_tex(FrameBuffer* tex, V3* tcs) {
+void TM::set_tex(Image* tex, V3* tcs) {
 	this->tex = tex;
 	this->tcs = tcs;
 }
 
 void TM::draw_points(unsigned int color, int psize, PPC *ppc, 
-	FrameBuffer *fb) {
+	Image *fb) {
 	for (int vi = 0; vi < num_verts; vi++) {
-		fb->draw_3d_point(verts[vi], ppc, psize, color);
+		fb->draw_3d_point(get_vert(vi), ppc, psize, color);
 	}
 }
 
 V3 TM::get_center() {
 	V3 ret(0.0f, 0.0f, 0.0f);
 	for (int vi = 0; vi < num_verts; vi++) {
-		ret = ret + verts[vi];
+		ret = ret + get_vert(vi);
 	}
 	return ret / (float) num_verts;
 }
 
 void TM::rotate_about_arbitrary_axis(V3 aO, V3 ad, float theta) {
-	for (int vi = 0; vi < num_verts; vi++) {
-		verts[vi] = verts[vi].rotate_point(aO, ad, theta);
-		normals[vi] = normals[vi].rotate_direction(ad, theta);
-	}
+	transform(Affine::make_rotation(aO, ad, theta));
 }
 
 void TM::create_face(V3 origin, V3 u_dir, V3 v_dir, int u_steps, int v_steps, V3 normal,
@@ -144,13 +158,13 @@ void TM::create_face(V3 origin, V3 u_dir, V3 v_dir, int u_steps, int v_steps, V3
     }
 }
 
-void TM::set_as_box(V3 p1, V3 p2, unsigned int color) {
+void TM::set_as_box(V3 p1, V3 p2, unsigned int color, float step) {
 	V3 min_p(fmin(p1[0], p2[0]), fmin(p1[1], p2[1]), fmin(p1[2], p2[2]));
 	V3 max_p(fmax(p1[0], p2[0]), fmax(p1[1], p2[1]), fmax(p1[2], p2[2]));
 
-	int x_steps = (int)(ceil(abs(max_p[0] - min_p[0]) / 2.0f));
-	int y_steps = (int)(ceil(abs(max_p[1] - min_p[1]) / 2.0f));
-	int z_steps = (int)(ceil(abs(max_p[2] - min_p[2]) / 2.0f));
+	int x_steps = (int)(ceil(abs(max_p[0] - min_p[0]) / step));
+	int y_steps = (int)(ceil(abs(max_p[1] - min_p[1]) / step));
+	int z_steps = (int)(ceil(abs(max_p[2] - min_p[2]) / step));
 
 	x_steps = max(1, x_steps);
 	y_steps = max(1, y_steps);
@@ -192,9 +206,16 @@ void TM::set_as_box(V3 p1, V3 p2, unsigned int color) {
 	create_face(min_p, dy, dz, y_steps, z_steps, V3(-1, 0, 0), color_vector, v_idx, t_idx);
 	// Right face
 	create_face(V3(max_p[0], min_p[1], min_p[2]), dy, dz, y_steps, z_steps, V3(1, 0, 0), color_vector, v_idx, t_idx);
+	mark_geometry_changed();
 }
 
 void TM::get_bounding_box(V3& p1, V3& p2) {
+	if (quantized && !verts) {
+		p1 = quantized->bounds_min;
+		p2 = quantized->bounds_max;
+		return;
+	}
+
 	V3 min = verts[0];
 	V3 max = verts[0];
 
@@ -250,14 +271,15 @@ void TM::set_as_quad(V3 p1, V3 p2, V3 p3, V3 p4, unsigned int color) {
 	tris[3] = 1;
 	tris[4] = 2;
 	tris[5] = 3;
+	mark_geometry_changed();
 }
 
-void TM::set_as_plane(V3 p1, V3 p2, unsigned int color) {
+void TM::set_as_plane(V3 p1, V3 p2, unsigned int color, float step) {
 	V3 min_p(fmin(p1[0], p2[0]), p1[1], fmin(p1[2], p2[2]));
 	V3 max_p(fmax(p1[0], p2[0]), p1[1], fmax(p1[2], p2[2]));
 
-	int x_steps = (int)(ceil(abs(max_p[0] - min_p[0]) / 2.0f));
-	int z_steps = (int)(ceil(abs(max_p[2] - min_p[2]) / 2.0f));
+	int x_steps = (int)(ceil(abs(max_p[0] - min_p[0]) / step));
+	int z_steps = (int)(ceil(abs(max_p[2] - min_p[2]) / step));
 
 	x_steps = max(1, x_steps);
 	z_steps = max(1, z_steps);
@@ -311,12 +333,37 @@ void TM::set_as_plane(V3 p1, V3 p2, unsigned int color) {
 			t_idx++;
 		}
 	}
+	mark_geometry_changed();
 }
 
-void TM::translate(V3 tv) {
-	for (int vi = 0; vi < num_verts; vi++) {
-		verts[vi] = verts[vi] + tv;
+void TM::transform(const Affine& xf) {
+	TraceScope trace("TM::transform");
+	float s = xf.linear[0][0];
+	if (quantized && !verts && s > 0.0f && xf.linear == M33(s)) {
+		quantized->scale_and_translate(s, xf.translation);
+		mark_geometry_changed();
+		return;
 	}
+	dequantize();
+	if (num_verts <= 0)
+		return;
+	own_attributes();
+
+	bool normalize_normals;
+	M33 normal_matrix = xf.get_normal_matrix(normalize_normals);
+	Affine normal_xf(normal_matrix, V3());
+	V3* vs = verts;
+	V3* ns = normal_matrix != M33(1.0f) ? normals : nullptr;
+	thread_pool()->parallel_for(num_verts, 8192, [&](int begin, int end) {
+		xf.transform_array(vs + begin, end - begin, true);
+		if (ns)
+			normal_xf.transform_array(ns + begin, end - begin, false, normalize_normals);
+	});
+	mark_geometry_changed();
+}
+
+void TM::translate(V3 tv) {
+	transform(Affine::make_translation(tv));
 }
 
 void TM::position(V3 new_center) {
@@ -324,13 +371,106 @@ void TM::position(V3 new_center) {
 }
 
 void TM::scale(float s) {
-	V3 center = get_center();
-	for (int vi = 0; vi < num_verts; vi++) {
-		verts[vi] = center + s * (verts[vi] - center);
+	transform(Affine::make_scale(s, get_center()));
+}
+
+void TM::mark_geometry_changed() {
+	geometry_version = next_geometry_version++;
+}
+
+TM TM::clone() {
+	TM copy;
+	copy.num_verts = num_verts;
+	copy.num_tris = num_tris;
+	if (num_verts <= 0)
+		return copy;
+
+	copy.verts = new V3[num_verts];
+	copy.projected_verts = new V3[num_verts];
+	copy.tris = new unsigned int[num_tris * 3];
+	bool has_colors = quantized && !verts ? quantized->colors != nullptr : colors != nullptr;
+	bool has_normals = quantized && !verts ? quantized->normals != nullptr : normals != nullptr;
+	copy.colors = has_colors ? new V3[num_verts] : nullptr;
+	copy.normals = has_normals ? new V3[num_verts] : nullptr;
+
+	if (verts) {
+		memcpy(copy.verts, verts, sizeof(V3) * num_verts);
+		memcpy(copy.tris, tris, sizeof(unsigned int) * num_tris * 3);
+		if (colors)
+			memcpy(copy.colors, colors, sizeof(V3) * num_verts);
+		if (normals)
+			memcpy(copy.normals, normals, sizeof(V3) * num_verts);
+	}
+	else {
+		quantized->decode(copy.verts, copy.colors, copy.normals, copy.tris);
 	}
+
+	if (tcs) {
+		copy.tcs = new V3[num_verts];
+		memcpy(copy.tcs, tcs, sizeof(V3) * num_verts);
+	}
+	copy.tex = tex;
+
+	copy.mark_geometry_changed();
+	return copy;
 }
 
-void TM::render_as_wireframe(PPC* ppc, FrameBuffer* fb, bool is_lighted) {
+TM TM::share() {
+	TM copy = *this;
+	copy.projected_verts = num_verts > 0 ? new V3[num_verts] : nullptr;
+	copy.lighted_colors = nullptr;
+	copy.diffuse_terms = nullptr;
+	copy.specular_terms = nullptr;
+	copy.shadowed = nullptr;
+	copy.lighting_cache = LightingCache();
+	copy.mesh_file = nullptr;
+	copy.owns_attributes = false;
+	copy.owns_tris = false;
+	if (quantized)
+		copy.quantized = quantized->share();
+	return copy;
+}
+
+void TM::own_attributes() {
+	// A mesh file of our own is mapped copy-on-write, it can be edited in place
+	if (owns_attributes || mesh_file || !verts)
+		return;
+
+	auto copy_array = [this](V3*& attribute) {
+		if (!attribute)
+			return;
+		V3* own = new V3[num_verts];
+		memcpy(own, attribute, sizeof(V3) * num_verts);
+		attribute = own;
+	};
+	copy_array(verts);
+	copy_array(colors);
+	copy_array(normals);
+	owns_attributes = true;
+}
+
+void TM::release() {
+	// arrays inside a mapped mesh file go away with the mapping
+	if (owns_attributes) {
+		delete[] verts;
+		delete[] colors;
+		delete[] normals;
+	}
+	if (owns_tris)
+		delete[] tris;
+	delete[] projected_verts;
+	delete[] lighted_colors;
+	delete[] diffuse_terms;
+	delete[] specular_terms;
+	delete[] shadowed;
+	delete quantized;
+	delete mesh_file;
+
+	*this = TM();
+}
+
+void TM::render_as_wireframe(PPC* ppc, Image* fb, bool is_lighted) {
+	dequantize();
 	for (int ti = 0; ti < num_tris; ti++) {
 		int v0 = tris[ti * 3 + 0];
 		int v1 = tris[ti * 3 + 1];
@@ -357,11 +497,27 @@ void TM::render_as_wireframe(PPC* ppc, FrameBuffer* fb, bool is_lighted) {
 	}
 }
 
-void TM::rasterize(PPC* ppc, FrameBuffer* fb, CubeMap* cube_map, render_type rt) {
+void TM::rasterize(PPC* ppc, Image* fb, CubeMap* cube_map, render_type rt, PixelLighting* pixel_lighting) {
+	TraceScope trace("TM::rasterize");
+	// Nothing to reflect without an environment, draw the vertex colors instead of crashing
+	if (rt == render_type::MIRROR_ONLY && !cube_map)
+		rt = render_type::NOT_LIGHTED;
+	if (quantized && !verts) {
+		if (rt != render_type::MIRROR_ONLY || quantized->normals) {
+			rasterize_quantized(ppc, fb, cube_map, rt, pixel_lighting);
+			return;
+		}
+		dequantize();
+	}
+
+	profile_count(profile_counter::TRIANGLES_SUBMITTED, num_tris);
+	ProfileScope projection(profile_stage::PROJECTION);
 	for (int vi = 0; vi < num_verts; vi++) {
 		ppc->project(verts[vi], projected_verts[vi]);
 	}
+	projection.stop();
 
+	int num_behind = 0;
 	for (int ti = 0; ti < num_tris; ti++) {
 		int v0 = tris[ti * 3 + 0];
 		int v1 = tris[ti * 3 + 1];
@@ -370,15 +526,17 @@ void TM::rasterize(PPC* ppc, FrameBuffer* fb, CubeMap* cube_map, render_type rt)
 		V3 V1 = projected_verts[v1];
 		V3 V2 = projected_verts[v2];
 
-		if (V0[0] == FLT_MAX || V1[0] == FLT_MAX || V2[0] == FLT_MAX) // Behind the camera
+		if (V0[0] == FLT_MAX || V1[0] == FLT_MAX || V2[0] == FLT_MAX) { // Behind the camera
+			num_behind++;
 			continue;
+		}
 
 		if (rt == render_type::MIRROR_ONLY) {
 			fb->draw_2d_mirrored_triangle(V0, V1, V2, normals[v0], normals[v1], normals[v2], ppc, cube_map);
 			continue;
 		}
 
-		if (tex && (rt == render_type::NORMAL_TILING_TEXTURED || rt == render_type::MIRRORED_TILING_TEXTURED)) {
+		if (tex && tcs && (rt == render_type::NORMAL_TILING_TEXTURED || rt == render_type::MIRRORED_TILING_TEXTURED)) {
 			V3 tex0 = tcs[v0];
 			V3 tex1 = tcs[v1];
 			V3 tex2 = tcs[v2];
@@ -386,6 +544,12 @@ void TM::rasterize(PPC* ppc, FrameBuffer* fb, CubeMap* cube_map, render_type rt)
 			continue;
 		}
 
+		if (rt == render_type::PIXEL_LIGHTED && pixel_lighting && normals) {
+			fb->draw_2d_lighted_triangle(V0, V1, V2, verts[v0], verts[v1], verts[v2],
+				normals[v0], normals[v1], normals[v2], colors[v0], colors[v1], colors[v2], pixel_lighting);
+			continue;
+		}
+
 		V3 C0, C1, C2;
 		if (rt == render_type::LIGHTED && lighted_colors) {
 			C0 = lighted_colors[v0];
@@ -400,13 +564,120 @@ void TM::rasterize(PPC* ppc, FrameBuffer* fb, CubeMap* cube_map, render_type rt)
 
 		fb->draw_2d_triangle(V0, V1, V2, C0, C1, C2);
 	}
+	profile_count(profile_counter::TRIANGLES_CULLED, num_behind);
+}
+
+// rasterize reading the quantized streams directly, lighted meshes use the lighted_colors of
+// light_point and friends and PIXEL_LIGHTED decodes the attributes per triangle
+void TM::rasterize_quantized(PPC* ppc, Image* fb, CubeMap* cube_map, render_type rt, PixelLighting* pixel_lighting) {
+	QuantizedMesh* q = quantized;
+	profile_count(profile_counter::TRIANGLES_SUBMITTED, num_tris);
+	ProfileScope projection(profile_stage::PROJECTION);
+	q->project(ppc, projected_verts);
+	projection.stop();
+
+	V3 white(1.0f, 1.0f, 1.0f);
+	int num_behind = 0;
+	for (int ti = 0; ti < num_tris; ti++) {
+		unsigned int v0 = q->get_index(ti * 3 + 0);
+		unsigned int v1 = q->get_index(ti * 3 + 1);
+		unsigned int v2 = q->get_index(ti * 3 + 2);
+		V3 V0 = projected_verts[v0];
+		V3 V1 = projected_verts[v1];
+		V3 V2 = projected_verts[v2];
+
+		if (V0[0] == FLT_MAX || V1[0] == FLT_MAX || V2[0] == FLT_MAX) { // Behind the camera
+			num_behind++;
+			continue;
+		}
+
+		if (rt == render_type::MIRROR_ONLY) {
+			fb->draw_2d_mirrored_triangle(V0, V1, V2, q->decode_normal(v0), q->decode_normal(v1), q->decode_normal(v2),
+				ppc, cube_map);
+			continue;
+		}
+
+		if (tex && tcs && (rt == render_type::NORMAL_TILING_TEXTURED || rt == render_type::MIRRORED_TILING_TEXTURED)) {
+			fb->draw_2d_texture_triangle(V0, V1, V2, tcs[v0], tcs[v1], tcs[v2],
+				rt == render_type::MIRRORED_TILING_TEXTURED, tex);
+			continue;
+		}
+
+		if (rt == render_type::PIXEL_LIGHTED && pixel_lighting && q->normals) {
+			fb->draw_2d_lighted_triangle(V0, V1, V2, q->decode_position(v0), q->decode_position(v1), q->decode_position(v2),
+				q->decode_normal(v0), q->decode_normal(v1), q->decode_normal(v2),
+				q->colors ? q->decode_color(v0) : white, q->colors ? q->decode_color(v1) : white,
+				q->colors ? q->decode_color(v2) : white, pixel_lighting);
+			continue;
+		}
+
+		if (rt == render_type::LIGHTED && lighted_colors)
+			fb->draw_2d_triangle(V0, V1, V2, lighted_colors[v0], lighted_colors[v1], lighted_colors[v2]);
+		else if (q->colors)
+			fb->draw_2d_triangle(V0, V1, V2, q->decode_color(v0), q->decode_color(v1), q->decode_color(v2));
+		else
+			fb->draw_2d_triangle(V0, V1, V2, white, white, white);
+	}
+	profile_count(profile_counter::TRIANGLES_CULLED, num_behind);
+}
+
+void TM::quantize() {
+	if (quantized || !verts || num_verts <= 0)
+		return;
+
+	quantized = new QuantizedMesh();
+	quantized->encode(verts, colors, normals, num_verts, tris, num_tris);
+
+	// float arrays inside a mapped mesh file are not ours to free
+	if (owns_attributes) {
+		delete[] verts;
+		delete[] colors;
+		delete[] normals;
+	}
+	if (owns_tris)
+		delete[] tris;
+	delete[] lighted_colors;
+	delete[] diffuse_terms;
+	delete[] specular_terms;
+	delete[] shadowed;
+
+	verts = nullptr;
+	colors = nullptr;
+	normals = nullptr;
+	tris = nullptr;
+	lighted_colors = nullptr;
+	diffuse_terms = nullptr;
+	specular_terms = nullptr;
+	shadowed = nullptr;
+	lighting_cache.valid = false;
+	mark_geometry_changed();
+
+	cerr << "INFO: quantized mesh to " << quantized->get_size_in_bytes() << " bytes" << endl;
+}
+
+void TM::dequantize() {
+	if (!quantized || verts)
+		return;
+
+	verts = new V3[num_verts];
+	colors = quantized->colors ? new V3[num_verts] : nullptr;
+	normals = quantized->normals ? new V3[num_verts] : nullptr;
+	tris = new unsigned int[num_tris * 3];
+	quantized->decode(verts, colors, normals, tris);
+	owns_attributes = true;
+	owns_tris = true;
+
+	delete quantized;
+	quantized = nullptr;
+	mark_geometry_changed();
 }
 
 void TM::set_eeqs(M33 proj_verts, M33& eeqs) {
 
 }
 
-void TM::visualize_normals(float nl, PPC* ppc, FrameBuffer* fb) {
+void TM::visualize_normals(float nl, PPC* ppc, Image* fb) {
+	dequantize();
 	if (!normals)
 		return;
 
@@ -416,33 +687,109 @@ void TM::visualize_normals(float nl, PPC* ppc, FrameBuffer* fb) {
 	}
 }
 
-void TM::light_point(ShadowMap* shadow_map, V3 eye_pos, float ka, int specular_exp) {
+// The float attributes lighting reads: the mesh's own arrays, or for a quantized mesh a
+// decoded copy in scratch that goes away after the lighting pass, so the mesh stays compact
+static void get_lighting_attributes(TM& tm, vector<V3>& scratch, V3*& verts, V3*& colors, V3*& normals) {
+	if (tm.verts || !tm.quantized) {
+		verts = tm.verts;
+		colors = tm.colors;
+		normals = tm.normals;
+		return;
+	}
+
+	QuantizedMesh* q = tm.quantized;
+	scratch.resize((size_t)tm.num_verts * 3);
+	verts = scratch.data();
+	colors = q->colors ? verts + tm.num_verts : nullptr;
+	normals = q->normals ? verts + 2 * tm.num_verts : nullptr;
+	q->decode(verts, colors, normals, nullptr);
+}
+
+// Only recomputes the lighting terms whose inputs changed since the last call:
+// geometry or light changes redo everything, a camera move or new specular exponent
+// only redoes the specular term and a new ambient factor only recombines.
+void TM::light_point(ShadowMap* shadow_map, V3 eye_pos, float ka, int specular_exp, bool use_shadows) {
+	TraceScope trace("TM::light_point");
+	ProfileScope lighting(profile_stage::LIGHTING);
+	if (num_verts <= 0)
+		return; // placeholder of a mesh that failed to load
+	LightingCache& lc = lighting_cache;
+
 	if (!lighted_colors)
 		lighted_colors = new V3[num_verts];
 
-	for (int vi = 0; vi < num_verts; vi++) {
-		if (shadow_map->in_shadow(verts[vi])) {
-			lighted_colors[vi] = colors[vi] * ka; // ambient only
-			continue;
-		}
-		V3 ld = shadow_map->pos - verts[vi];
-		V3 view_dir = eye_pos - verts[vi];
-		lighted_colors[vi] = colors[vi].lighted(normals[vi], ld, view_dir, ka, specular_exp);
+	if (!diffuse_terms || lc.num_verts != num_verts) {
+		delete[] diffuse_terms;
+		delete[] specular_terms;
+		delete[] shadowed;
+		diffuse_terms = new float[num_verts];
+		specular_terms = new float[num_verts];
+		shadowed = new unsigned char[num_verts];
+		lc.num_verts = num_verts;
+		lc.valid = false;
 	}
+
+	bool diffuse_dirty = !lc.valid || lc.geometry_version != geometry_version ||
+		lc.shadow_version != shadow_map->version || lc.light_pos != shadow_map->pos || lc.shadows != use_shadows;
+	bool specular_dirty = diffuse_dirty || lc.eye_pos != eye_pos || lc.specular_exp != specular_exp;
+	bool combine_dirty = specular_dirty || lc.ka != ka;
+
+	vector<V3> scratch;
+	V3* vs = nullptr;
+	V3* cs = nullptr;
+	V3* ns = nullptr;
+	if (combine_dirty)
+		get_lighting_attributes(*this, scratch, vs, cs, ns);
+
+	if (specular_dirty) {
+		light_vertex_terms(vs, ns, num_verts, use_shadows ? shadow_map : nullptr, shadow_map->pos, eye_pos, specular_exp,
+			diffuse_dirty ? diffuse_terms : nullptr, shadowed, specular_terms);
+	}
+
+	if (combine_dirty) {
+		combine_lighting(cs, diffuse_terms, shadowed, specular_terms, num_verts, ka, lighted_colors);
+	}
+
+	lc.valid = true;
+	lc.geometry_version = geometry_version;
+	lc.shadow_version = shadow_map->version;
+	lc.light_pos = shadow_map->pos;
+	lc.shadows = use_shadows;
+	lc.eye_pos = eye_pos;
+	lc.ka = ka;
+	lc.specular_exp = specular_exp;
 }
 
-void TM::light_directional(ShadowMap* shadow_map, V3 eye_pos, float ka, int specular_exp) {
+void TM::light_points(vector<PointLight*>& lights, LightGrid* grid, PPC* ppc, float ka, int specular_exp) {
+	TraceScope trace("TM::light_points");
+	ProfileScope lighting(profile_stage::LIGHTING);
+	if (num_verts <= 0)
+		return; // placeholder of a mesh that failed to load
 	if (!lighted_colors)
 		lighted_colors = new V3[num_verts];
 
-	for (int vi = 0; vi < num_verts; vi++) {
-		if (shadow_map->in_shadow(verts[vi])) {
-			lighted_colors[vi] = colors[vi] * ka; // ambient only
-			continue;
-		}
+	vector<V3> scratch;
+	V3 *vs, *cs, *ns;
+	get_lighting_attributes(*this, scratch, vs, cs, ns);
+	light_vertices_tiled(vs, ns, cs, num_verts, lights.data(), (int)lights.size(), grid, ppc,
+		ka, specular_exp, lighted_colors);
 
-		lighted_colors[vi] = colors[vi].lighted(normals[vi], shadow_map->pos, eye_pos, ka, specular_exp);
-	}
+	lighting_cache.valid = false; // lighted_colors no longer hold the single light result
+}
+
+void TM::light_directional(DirectionalShadowMap* shadow_map, V3 eye_pos, float ka, int specular_exp) {
+	TraceScope trace("TM::light_directional");
+	ProfileScope lighting(profile_stage::LIGHTING);
+	if (num_verts <= 0)
+		return; // placeholder of a mesh that failed to load
+	if (!lighted_colors)
+		lighted_colors = new V3[num_verts];
+
+	vector<V3> scratch;
+	V3 *vs, *cs, *ns;
+	get_lighting_attributes(*this, scratch, vs, cs, ns);
+	light_vertices_directional(vs, ns, cs, num_verts, shadow_map, eye_pos, ka, specular_exp,
+		lighted_colors);
 }
 
 // loading triangle mesh from a binary file, i.e., a .bin file from geometry folder
@@ -494,12 +841,12 @@ void TM::load_bin(char *fname) {
 	}
 
 	ifs.read(&yn, 1); // texture coordinates 2 floats
-	float* tcs = 0;
 	/*if (tcs)
 		delete []tcs;*/
 	tcs = 0;
+	float* file_tcs = 0;
 	if (yn == 'y') {
-		tcs = new float[num_verts * 2];
+		file_tcs = new float[num_verts * 2];
 	}
 
 
@@ -512,8 +859,14 @@ void TM::load_bin(char *fname) {
 	if (normals)
 		ifs.read((char*)normals, num_verts * 3 * sizeof(float)); // load normals
 
-	if (tcs)
-		ifs.read((char*)tcs, num_verts * 2 * sizeof(float)); // load texture coordinates
+	if (file_tcs) {
+		ifs.read((char*)file_tcs, num_verts * 2 * sizeof(float)); // load texture coordinates
+		tcs = new V3[num_verts];
+		for (int vi = 0; vi < num_verts; vi++) {
+			tcs[vi] = V3(file_tcs[vi * 2 + 0], file_tcs[vi * 2 + 1], 0.0f);
+		}
+		delete[] file_tcs;
+	}
 
 	ifs.read((char*)&num_tris, sizeof(int));
 	/*if (tris)
@@ -523,7 +876,82 @@ void TM::load_bin(char *fname) {
 
 	ifs.close();
 
+	// lighting needs normals, meshes baked with MeshBaker already have them
+	if (!normals) {
+		normals = new V3[num_verts];
+		generate_normals(verts, num_verts, tris, num_tris, normals);
+		cerr << "INFO: generated missing normals for " << fname << endl;
+	}
+	mark_geometry_changed();
+
 	cerr << "INFO: loaded " << num_verts << " verts, " << num_tris << " tris from " << endl << "      " << fname << endl;
 	cerr << "      xyz " << ((colors) ? "rgb " : "") << ((normals) ? "nxnynz " : "") << ((tcs) ? "tcstct " : "") << endl;
 
+	// shading reads the vertex colors, meshes without them are drawn white
+	if (!colors) {
+		colors = new V3[num_verts];
+		for (int vi = 0; vi < num_verts; vi++)
+			colors[vi] = V3(1.0f, 1.0f, 1.0f);
+	}
+
+}
+
+// maps a mesh file written by save_mesh_file, the attribute streams are used in place
+bool TM::load_mesh_file(char* fname) {
+	MeshFile* file = new MeshFile();
+	if (!file->open(fname)) {
+		delete file;
+		return false;
+	}
+
+	mesh_file = file;
+	owns_attributes = false;
+	owns_tris = false;
+	num_verts = (int)file->header->num_verts;
+	num_tris = (int)file->header->num_tris;
+	tcs = file->get_tcs();
+	projected_verts = new V3[num_verts];
+	lighted_colors = nullptr;
+
+	if (file->is_quantized()) {
+		// rendered straight from the mapped streams until something needs float data
+		quantized = new QuantizedMesh();
+		file->get_quantized(quantized);
+		verts = nullptr;
+		colors = nullptr;
+		normals = nullptr;
+		tris = nullptr;
+		mark_geometry_changed();
+
+		cerr << "INFO: mapped " << num_verts << " quantized verts, " << num_tris << " tris from " << endl << "      " << fname << endl;
+		return true;
+	}
+
+	verts = file->get_verts();
+	colors = file->get_colors();
+	normals = file->get_normals();
+
+	if (file->has_16bit_indices()) {
+		// the rasterizers index with unsigned int, widen the smaller stream once
+		unsigned short* tris_16 = (unsigned short*)file->get_tris();
+		tris = new unsigned int[num_tris * 3];
+		owns_tris = true;
+		for (int i = 0; i < num_tris * 3; i++) {
+			tris[i] = tris_16[i];
+		}
+	}
+	else {
+		tris = (unsigned int*)file->get_tris();
+	}
+
+	mark_geometry_changed();
+
+	cerr << "INFO: mapped " << num_verts << " verts, " << num_tris << " tris from " << endl << "      " << fname << endl;
+	return true;
+}
+
+bool TM::save_mesh_file(char* fname, bool allow_16bit_indices) {
+	if (quantized && !verts)
+		return MeshFile::write_quantized(fname, quantized, tcs);
+	return MeshFile::write(fname, verts, colors, normals, tcs, num_verts, tris, num_tris, allow_16bit_indices);
 }
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cmath>
+#include <ostream>
+#include "v3.h"
+#include "m33.h"
+
+// Affine transform p' = linear * p + translation, the top three rows of a 4x4 homogeneous
+// matrix (the bottom row is always 0 0 0 1, so it is not stored). Header only like M33, built
+// once per edit so applying it to a mesh is one multiply-add per vertex instead of rebuilding
+// a basis and rotation per vertex like V3::rotate_point does.
+class alignas(16) Affine {
+public:
+	M33 linear;
+	V3 translation;
+
+	Affine() : linear(1.0f) {}
+	Affine(const M33& _linear, V3 _translation) : linear(_linear), translation(_translation) {}
+
+	static Affine make_translation(V3 tv) { return Affine(M33(1.0f), tv); }
+
+	// Uniform scale by s about center
+	static Affine make_scale(float s, V3 center) { return Affine(M33(s), center - s * center); }
+
+	// Same basis as V3::rotate_point, rotation of angle_degrees about the axis through aO along ad
+	static Affine make_rotation(V3 aO, V3 ad, float angle_degrees) {
+		V3 axis = ad.normalized();
+		V3 temp = (fabsf(axis[0]) < fabsf(axis[1])) ? V3(1, 0, 0) : V3(0, 1, 0);
+		V3 u = (temp ^ axis).normalized();
+		V3 v = (axis ^ u).normalized();
+		M33 basis(u, v, axis);
+
+		M33 rotation_matrix;
+		rotation_matrix.set_as_z_rotation(angle_degrees);
+
+		M33 r = basis.transposed() * rotation_matrix * basis;
+		return Affine(r, aO - r * aO);
+	}
+
+	// Applies m first, then this
+	Affine operator*(const Affine& m) const { return Affine(linear * m.linear, linear * m.translation + translation); }
+
+	V3 transform_point(const V3& p) const { return linear * p + translation; }
+	V3 transform_direction(const V3& d) const { return linear * d; }
+
+	Affine inverted() const {
+		M33 inv = linear.inverted();
+		return Affine(inv, -1.0f * (inv * translation));
+	}
+
+	// Matrix for normals. Rotations and uniform scales (linear * linear^T = k * I) keep normals
+	// perpendicular with linear itself, divided by sqrt(k) so their lengths are kept too. Anything
+	// else, shears and non-uniform scales, needs the inverse transpose and renormalizing after.
+	M33 get_normal_matrix(bool& needs_normalize) const {
+		M33 llt = linear * linear.transposed();
+		float k = (llt[0][0] + llt[1][1] + llt[2][2]) / 3.0f;
+		bool conformal = k > 0.0f;
+		for (int i = 0; i < 3 && conformal; i++) {
+			for (int j = 0; j < 3; j++) {
+				if (fabsf(llt[i][j] - (i == j ? k : 0.0f)) > 1e-4f * k)
+					conformal = false;
+			}
+		}
+
+		needs_normalize = !conformal;
+		if (!conformal)
+			return linear.inverted().transposed();
+
+		M33 n = fabsf(k - 1.0f) < 1e-4f ? linear : M33(1.0f / sqrtf(k)) * linear;
+		// Snaps to exactly the identity for translations and scales, which leave normals alone
+		M33 identity(1.0f);
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++) {
+				if (fabsf(n[i][j] - identity[i][j]) > 1e-6f)
+					return n;
+			}
+		}
+		return identity;
+	}
+
+	friend ostream& operator<<(ostream& ostr, const Affine& m) { return ostr << m.linear << endl << m.translation; }
+
+	// Transforms points[0, count) in place, with translation when is_point, as directions without.
+	// The SSE path keeps the three columns in registers and reads each vertex as four floats, so
+	// the last vertex, which has nothing after it to over-read, goes through the scalar path.
+	void transform_array(V3* points, int count, bool is_point, bool normalize = false) const {
+		int i = 0;
+#if GP_SSE
+		__m128 c0 = _mm_setr_ps(linear[0][0], linear[1][0], linear[2][0], 0.0f);
+		__m128 c1 = _mm_setr_ps(linear[0][1], linear[1][1], linear[2][1], 0.0f);
+		__m128 c2 = _mm_setr_ps(linear[0][2], linear[1][2], linear[2][2], 0.0f);
+		__m128 t = is_point ? _mm_setr_ps(translation[0], translation[1], translation[2], 0.0f) : _mm_setzero_ps();
+		for (; i < count - 1; i++) {
+			__m128 p = _mm_loadu_ps(points[i].xyz);
+			__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_shuffle_ps(p, p, _MM_SHUFFLE(0, 0, 0, 0))),
+				_mm_mul_ps(c1, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1)))),
+				_mm_add_ps(_mm_mul_ps(c2, _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2))), t));
+			if (normalize) {
+				__m128 len2 = _mm_mul_ps(r, r);
+				len2 = _mm_add_ps(len2, _mm_shuffle_ps(len2, len2, _MM_SHUFFLE(2, 3, 0, 1)));
+				len2 = _mm_add_ps(len2, _mm_shuffle_ps(len2, len2, _MM_SHUFFLE(1, 0, 3, 2)));
+				// Zero vectors stay zero like V3::normalized
+				__m128 nonzero = _mm_cmpgt_ps(len2, _mm_setzero_ps());
+				r = _mm_and_ps(_mm_div_ps(r, _mm_sqrt_ps(len2)), nonzero);
+			}
+			// Stores x, y then z, a four float store would overwrite x of the next vertex
+			_mm_storel_pi((__m64*)points[i].xyz, r);
+			_mm_store_ss(points[i].xyz + 2, _mm_movehl_ps(r, r));
+		}
+#endif
+		for (; i < count; i++) {
+			V3 r = is_point ? transform_point(points[i]) : transform_direction(points[i]);
+			points[i] = normalize ? r.normalized() : r;
+		}
+	}
+};
@@ -0,0 +1,332 @@
+#include "asset_cache.h"
+#include "image.h"
+#include "image_io.h"
+
+#include <cstdio>
+#include <iostream>
+
+using namespace std;
+
+uint64_t hash_file(const char* fname, bool& ok) {
+	ok = false;
+	FILE* f = fopen(fname, "rb");
+	if (!f)
+		return 0;
+
+	uint64_t hash = 14695981039346656037ull;
+	vector<unsigned char> buffer(1 << 16);
+	size_t n;
+	while ((n = fread(buffer.data(), 1, buffer.size(), f)) > 0) {
+		for (size_t i = 0; i < n; i++) {
+			hash ^= buffer[i];
+			hash *= 1099511628211ull;
+		}
+	}
+	fclose(f);
+
+	ok = true;
+	return hash;
+}
+
+// Maps the .gpt next to fname when it was written from the current file, otherwise
+// decodes fname and writes the .gpt so the next run can map it
+static bool load_image_pixels(const string& fname, CachedImage& image) {
+	uint64_t source_size = 0;
+	int64_t source_mtime = 0;
+	get_file_stamp(fname.c_str(), source_size, source_mtime);
+
+	string texture_fname = get_texture_file_path(fname);
+	uint64_t size;
+	int64_t mtime;
+	if (get_file_stamp(texture_fname.c_str(), size, mtime) && image.mapped.open((char*)texture_fname.c_str())) {
+		TextureFileHeader* h = image.mapped.header;
+		if (h->source_size == source_size && h->source_mtime == source_mtime) {
+			image.w = image.mapped.get_width();
+			image.h = image.mapped.get_height();
+			image.pix = image.mapped.get_texels();
+			return true;
+		}
+		image.mapped.file.close();
+		image.mapped.header = nullptr;
+	}
+
+	if (!read_tiff_rgba((char*)fname.c_str(), image.w, image.h, image.storage))
+		return false;
+	image.pix = image.storage.data();
+
+	if (source_size > 0 && TextureFile::write((char*)texture_fname.c_str(), image.pix, image.w, image.h, source_size, source_mtime))
+		cerr << "INFO: wrote " << texture_fname << endl;
+	return true;
+}
+
+static size_t get_mesh_bytes(TM& tm) {
+	size_t per_vert = sizeof(V3) * (2 + (tm.colors ? 1 : 0) + (tm.normals ? 1 : 0) + (tm.tcs ? 1 : 0));
+	return per_vert * tm.num_verts + sizeof(unsigned int) * 3 * tm.num_tris;
+}
+
+AssetCache::AssetCache(size_t _memory_budget) {
+	memory_budget = _memory_budget;
+	memory_used = 0;
+	next_key = 1;
+}
+
+bool AssetCache::lookup_key(const string& fname, uint64_t& key) {
+	uint64_t size;
+	int64_t mtime;
+	if (!get_file_stamp(fname.c_str(), size, mtime)) {
+		cerr << "ERROR: cannot open " << fname << endl;
+		return false;
+	}
+
+	// Cached files of the same size that might be a copy of this one
+	vector<pair<uint64_t, string>> unhashed;
+	vector<uint64_t> candidates;
+	{
+		lock_guard<mutex> lock(mtx);
+		auto it = path_keys.find(fname);
+		if (it != path_keys.end() && it->second.size == size && it->second.mtime == mtime) {
+			key = it->second.key;
+			return true;
+		}
+
+		for (auto& e : entries) {
+			if (e.second.file_size != size || e.second.fname.empty())
+				continue;
+			candidates.push_back(e.first);
+			if (!e.second.hashed)
+				unhashed.push_back(make_pair(e.first, e.second.fname));
+		}
+
+		if (candidates.empty()) {
+			key = next_key++;
+			Entry& entry = entries[key];
+			entry.fname = fname;
+			entry.file_size = size;
+			path_keys[fname] = { size, mtime, key };
+			return true;
+		}
+	}
+
+	// Outside the lock so other loads go on while the files are read
+	bool ok;
+	uint64_t hash = hash_file(fname.c_str(), ok);
+	if (!ok) {
+		cerr << "ERROR: cannot open " << fname << endl;
+		return false;
+	}
+	vector<uint64_t> candidate_hashes;
+	for (auto& c : unhashed) {
+		bool candidate_ok;
+		candidate_hashes.push_back(hash_file(c.second.c_str(), candidate_ok));
+		if (!candidate_ok)
+			candidate_hashes.back() = hash + 1; // gone, cannot match
+	}
+
+	lock_guard<mutex> lock(mtx);
+	for (size_t i = 0; i < unhashed.size(); i++) {
+		auto it = entries.find(unhashed[i].first);
+		if (it != entries.end() && !it->second.hashed) {
+			it->second.hash = candidate_hashes[i];
+			it->second.hashed = true;
+		}
+	}
+
+	key = 0;
+	for (uint64_t candidate : candidates) {
+		auto it = entries.find(candidate);
+		if (it != entries.end() && it->second.hashed && it->second.hash == hash) {
+			key = candidate;
+			break;
+		}
+	}
+	if (key == 0) {
+		key = next_key++;
+		Entry& entry = entries[key];
+		entry.fname = fname;
+		entry.file_size = size;
+		entry.hash = hash;
+		entry.hashed = true;
+	}
+	path_keys[fname] = { size, mtime, key };
+	return true;
+}
+
+void AssetCache::add_ref(Entry& entry) {
+	entry.refs++;
+	if (entry.in_lru) {
+		lru.erase(entry.lru_it);
+		entry.in_lru = false;
+	}
+}
+
+void AssetCache::make_evictable(uint64_t key, Entry& entry) {
+	if (entry.refs > 0 || entry.in_lru)
+		return;
+	lru.push_back(key);
+	entry.lru_it = prev(lru.end());
+	entry.in_lru = true;
+}
+
+void AssetCache::set_bytes(Entry& entry, size_t bytes) {
+	memory_used += bytes - entry.bytes;
+	entry.bytes = bytes;
+}
+
+shared_ptr<const CachedImage> AssetCache::get_image(const string& fname) {
+	uint64_t key;
+	if (!lookup_key(fname, key))
+		return nullptr;
+
+	{
+		lock_guard<mutex> lock(mtx);
+		Entry& entry = entries[key];
+		if (entry.image)
+			return entry.image;
+		if (entry.texture) {
+			// The pixels live in the texture now, hand out a copy instead of decoding again
+			shared_ptr<CachedImage> image = make_shared<CachedImage>();
+			image->w = entry.texture->w;
+			image->h = entry.texture->h;
+			image->storage.assign(entry.texture->pix, entry.texture->pix + image->w * image->h);
+			image->pix = image->storage.data();
+			return image;
+		}
+		make_evictable(key, entry);
+	}
+
+	shared_ptr<CachedImage> image = make_shared<CachedImage>();
+	if (!load_image_pixels(fname, *image))
+		return nullptr;
+
+	lock_guard<mutex> lock(mtx);
+	Entry& entry = entries[key];
+	if (entry.image) // decoded by another thread in the meantime
+		return entry.image;
+	entry.image = image;
+	set_bytes(entry, entry.bytes + (size_t)image->w * image->h * sizeof(unsigned int));
+	make_evictable(key, entry);
+	evict();
+	return image;
+}
+
+Image* AssetCache::acquire_texture(const string& fname) {
+	uint64_t key;
+	if (!lookup_key(fname, key))
+		return nullptr;
+
+	{
+		lock_guard<mutex> lock(mtx);
+		Entry& entry = entries[key];
+		if (entry.texture) {
+			add_ref(entry);
+			return entry.texture;
+		}
+	}
+
+	shared_ptr<const CachedImage> image = get_image(fname);
+	if (!image)
+		return nullptr;
+
+	// Textures are only sampled, they need no depth
+	Image* texture = new Image(image->w, image->h, false);
+	texture->set_pixels(image->w, image->h, image->pix);
+
+	lock_guard<mutex> lock(mtx);
+	Entry& entry = entries[key];
+	if (entry.texture) { // created by another thread in the meantime
+		delete texture;
+	}
+	else {
+		entry.texture = texture;
+		entry.image = nullptr;
+		set_bytes(entry, sizeof(unsigned int) * image->w * image->h + (entry.has_mesh ? get_mesh_bytes(entry.mesh) : 0));
+	}
+	add_ref(entry);
+	evict();
+	return entry.texture;
+}
+
+bool AssetCache::acquire_mesh(const string& fname, TM& tm) {
+	uint64_t key;
+	if (!lookup_key(fname, key))
+		return false;
+
+	{
+		lock_guard<mutex> lock(mtx);
+		Entry& entry = entries[key];
+		if (entry.has_mesh) {
+			add_ref(entry);
+			tm = entry.mesh.share();
+			return true;
+		}
+	}
+
+	TM loaded((char*)fname.c_str());
+	if (loaded.num_verts == 0)
+		return false;
+
+	lock_guard<mutex> lock(mtx);
+	Entry& entry = entries[key];
+	if (entry.has_mesh) { // loaded by another thread in the meantime
+		loaded.release();
+	}
+	else {
+		entry.mesh = loaded;
+		entry.has_mesh = true;
+		set_bytes(entry, entry.bytes + get_mesh_bytes(entry.mesh));
+	}
+	add_ref(entry);
+	tm = entry.mesh.share();
+	evict();
+	return true;
+}
+
+void AssetCache::release(const string& fname) {
+	lock_guard<mutex> lock(mtx);
+	auto path_it = path_keys.find(fname);
+	if (path_it == path_keys.end())
+		return;
+
+	uint64_t key = path_it->second.key;
+	Entry& entry = entries[key];
+	if (entry.refs <= 0) {
+		cerr << "ERROR: " << fname << " released more often than acquired" << endl;
+		return;
+	}
+
+	entry.refs--;
+	make_evictable(key, entry);
+	evict();
+}
+
+size_t AssetCache::get_memory_used() {
+	lock_guard<mutex> lock(mtx);
+	return memory_used;
+}
+
+void AssetCache::evict() {
+	auto it = lru.begin();
+	while (memory_used > memory_budget && it != lru.end()) {
+		uint64_t key = *it;
+		Entry& entry = entries[key];
+
+		delete entry.texture;
+		if (entry.has_mesh)
+			entry.mesh.release();
+		memory_used -= entry.bytes;
+
+		it = lru.erase(it);
+		entries.erase(key);
+		for (auto path_it = path_keys.begin(); path_it != path_keys.end();) {
+			if (path_it->second.key == key)
+				path_it = path_keys.erase(path_it);
+			else
+				++path_it;
+		}
+	}
+}
+
+AssetCache* asset_cache() {
+	static AssetCache cache(256 * 1024 * 1024);
+	return &cache;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "tm.h"
+#include "texture_file.h"
+
+class Image;
+
+struct CachedImage {
+	int w = 0, h = 0;
+	const unsigned int* pix = nullptr; // RGBA8, bottom row first, see read_tiff_rgba; points into storage or the mapped .gpt
+	std::vector<unsigned int> storage; // empty when the pixels are mapped
+	TextureFile mapped;
+};
+
+// Meshes and images loaded once and shared. Entries are found by path, size and
+// modification time, so an edited file gets a new entry. Only when a new path has the same
+// size as a cached file are both hashed, so a copy under another name is not decoded again.
+// acquire_* counts a reference that release drops; entries nobody references stay cached
+// until the memory budget is exceeded and are then evicted least recently used first.
+class AssetCache {
+public:
+	AssetCache(size_t _memory_budget);
+
+	// Thread safe. Decoded pixels of a TIFF, mapped from its .gpt when that is up to date, null when it cannot be read. Not counted as a
+	// reference, the returned pointer keeps the pixels alive even if the entry is evicted.
+	std::shared_ptr<const CachedImage> get_image(const std::string& fname);
+
+	// Thread safe. Texture shared by every mesh using fname.
+	Image* acquire_texture(const std::string& fname);
+
+	// Thread safe. Sets tm to a TM::share of the cached mesh, which copies the arrays only once
+	// it is transformed; false when the file cannot be loaded. The arrays stay valid until
+	// release.
+	bool acquire_mesh(const std::string& fname, TM& tm);
+
+	void release(const std::string& fname);
+
+	size_t get_memory_used();
+	size_t memory_budget;
+
+private:
+	struct Entry {
+		std::string fname; // first path the entry was loaded from
+		uint64_t file_size = 0;
+		uint64_t hash = 0; // of the contents, only computed when another file has the same size
+		bool hashed = false;
+		int refs = 0;
+		std::shared_ptr<CachedImage> image; // dropped once texture holds the pixels
+		Image* texture = nullptr;
+		TM mesh; // pristine copy, handed out through TM::share
+		bool has_mesh = false;
+		size_t bytes = 0;
+		bool in_lru = false;
+		std::list<uint64_t>::iterator lru_it; // valid while in_lru
+	};
+
+	struct PathKey {
+		uint64_t size;
+		int64_t mtime;
+		uint64_t key;
+	};
+
+	std::mutex mtx;
+	std::map<std::string, PathKey> path_keys;
+	std::map<uint64_t, Entry> entries;
+	uint64_t next_key;
+	std::list<uint64_t> lru; // unreferenced entries, least recently used at the front
+	size_t memory_used;
+
+	bool lookup_key(const std::string& fname, uint64_t& key); // the entry of fname as it is on disk now
+	void add_ref(Entry& entry);
+	void make_evictable(uint64_t key, Entry& entry);
+	void set_bytes(Entry& entry, size_t bytes);
+	void evict();
+};
+
+AssetCache* asset_cache(); // shared cache used by the scene, AssetLoader and CubeMap
+
+uint64_t hash_file(const char* fname, bool& ok); // 64 bit FNV-1a of the file contents
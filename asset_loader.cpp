@@ -0,0 +1,144 @@
+#include "asset_loader.h"
+#include "asset_cache.h"
+#include "cube_map.h"
+#include "image.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "tm.h"
+
+#include <iostream>
+#include <memory>
+
+using namespace std;
+
+AssetLoader::AssetLoader() {
+	pending = 0;
+	running = 0;
+}
+
+AssetLoader::~AssetLoader() {
+	unique_lock<mutex> lock(mtx);
+	cv.wait(lock, [this] { return running == 0; });
+}
+
+void AssetLoader::run(function<function<void()>()> job) {
+	{
+		lock_guard<mutex> lock(mtx);
+		pending++;
+		running++;
+	}
+
+	// Without workers nothing would ever pick the job up
+	if (io_pool()->num_workers() == 0) {
+		function<void()> install = job();
+		lock_guard<mutex> lock(mtx);
+		finished.push_back(install ? install : [] {});
+		running--;
+		return;
+	}
+
+	io_pool()->enqueue([this, job] {
+		function<void()> install;
+		{
+			TraceScope trace("AssetLoader job");
+			install = job();
+		}
+
+		lock_guard<mutex> lock(mtx);
+		// Failed loads have nothing to install but still have to be counted off by poll
+		finished.push_back(install ? install : [] {});
+		running--;
+		cv.notify_all();
+	});
+}
+
+void AssetLoader::load_mesh(TM* tm, const string& fname, function<void(TM&)> setup) {
+	run([tm, fname, setup]() -> function<void()> {
+		shared_ptr<TM> loaded = make_shared<TM>();
+		if (!asset_cache()->acquire_mesh(fname, *loaded)) {
+			cerr << "ERROR: mesh " << fname << " could not be loaded" << endl;
+			return nullptr;
+		}
+		if (setup)
+			setup(*loaded);
+
+		return [tm, loaded, fname] {
+			// A texture can finish before its mesh, keep whatever was already set
+			Image* tex = tm->tex;
+			V3* tcs = tm->tcs;
+			// Frees the placeholder's arrays, then moves the loaded ones over
+			tm->release();
+			*tm = *loaded;
+			*loaded = TM();
+			if (tex)
+				tm->tex = tex;
+			if (tcs)
+				tm->tcs = tcs;
+			if (tm->tex && !tm->tcs) {
+				cerr << "ERROR: mesh " << fname << " has no texture coordinates, drawing it without its texture" << endl;
+				tm->tex = nullptr;
+			}
+		};
+	});
+}
+
+void AssetLoader::load_texture(TM* tm, const string& fname, V3* tcs) {
+	run([tm, fname, tcs]() -> function<void()> {
+		Image* tex = asset_cache()->acquire_texture(fname);
+		if (!tex)
+			return nullptr;
+
+		return [tm, tex, tcs, fname] {
+			// Without a mesh yet the mesh's install checks for texture coordinates
+			if (!tcs && !tm->tcs && tm->num_verts > 0) {
+				cerr << "ERROR: texture " << fname << " is for a mesh without texture coordinates" << endl;
+				return;
+			}
+			tm->set_tex(tex, tcs ? tcs : tm->tcs);
+		};
+	});
+}
+
+void AssetLoader::load_cube_map(CubeMap** cube_map, const string& fname) {
+	run([cube_map, fname]() -> function<void()> {
+		shared_ptr<const CachedImage> image = asset_cache()->get_image(fname);
+		if (!image)
+			return nullptr;
+
+		return [cube_map, image] {
+			*cube_map = new CubeMap(image->pix, image->w, image->h);
+		};
+	});
+}
+
+int AssetLoader::poll() {
+	vector<function<void()>> ready;
+	{
+		lock_guard<mutex> lock(mtx);
+		ready.swap(finished);
+	}
+
+	for (function<void()>& install : ready) {
+		install();
+	}
+
+	lock_guard<mutex> lock(mtx);
+	pending -= (int)ready.size();
+	return (int)ready.size();
+}
+
+void AssetLoader::wait_all() {
+	while (true) {
+		poll();
+
+		unique_lock<mutex> lock(mtx);
+		if (pending == 0)
+			return;
+		cv.wait(lock, [this] { return !finished.empty(); });
+	}
+}
+
+int AssetLoader::get_pending() {
+	lock_guard<mutex> lock(mtx);
+	return pending;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class TM;
+class V3;
+class CubeMap;
+
+// Loads meshes and decodes textures in parallel on the I/O thread pool. Handing the
+// results to the scene is queued and done by poll() on the rendering thread, so the scene
+// keeps rendering while assets stream in: a mesh is empty until its load is installed, and a textured mesh is
+// drawn with its vertex colors until its texture is.
+class AssetLoader {
+public:
+	AssetLoader();
+	~AssetLoader(); // waits for loads still running on the pool, they point into this loader
+
+	// Loads fname into *tm, setup runs on the worker right after the load (transforms etc.)
+	void load_mesh(TM* tm, const std::string& fname, std::function<void(TM&)> setup = nullptr);
+	// Decodes fname and sets it as tm's texture, with tcs when given, else the mesh's own
+	void load_texture(TM* tm, const std::string& fname, V3* tcs = nullptr);
+	// Decodes a cross layout image and sets *cube_map once the faces are built
+	void load_cube_map(CubeMap** cube_map, const std::string& fname);
+
+	// Generic form, job runs on a worker and returns the step to run on the GUI thread
+	void run(std::function<std::function<void()>()> job);
+
+	int poll(); // installs finished loads, returns how many were installed
+	void wait_all(); // blocks, installing loads as they finish, until none are pending
+	int get_pending();
+
+private:
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::vector<std::function<void()>> finished;
+	int pending; // queued or running jobs, including finished ones not yet installed
+	int running; // jobs still on the pool
+
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+};
@@ -0,0 +1,210 @@
+// Headless batch renderer. Loads a scene file and a camera path (the cameras.bin format of
+// load_from_file) and renders every interpolated frame without opening a window.
+//
+// usage: BatchRenderer [-scene file] [-cameras file] [-frames n] [-rt type] [-o dir] [-compress type]
+//                      [-raw file] [-y4m file] [-fps n] [-lights] [-trace file]
+//                      [-heatmap metric]
+//   -cameras defaults to the cameras line of the scene file
+//   -frames is the total over the whole path, 1500 like render_cameras_as_frames
+//   -rt is one of lighted, pixel_lighted, not_lighted, textured, mirrored_textured, mirror (default not_lighted)
+//   -o writes each frame as dir/frame_0000.tiff from a background thread
+//   -compress is the TIFF compression of -o, one of none, lzw, deflate, packbits (default none)
+//   -raw streams the frames as top row first RGBA8 into one file, - for stdout
+//   -y4m streams them as YUV4MPEG2 4:2:0 instead, at -fps frames per second (default 30), e.g.
+//        BatchRenderer -y4m - | ffmpeg -i - path.mp4
+//   -lights draws the point light markers
+//   -heatmap renders the per-pixel count of tests, writes or shaded (depth tests, depth writes,
+//            shader invocations) as colors instead of the frames, see Heatmap::draw
+//   -trace saves a per-thread timeline of the rendering as Chrome trace JSON (chrome://tracing, ui.perfetto.dev)
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "image_writer.h"
+#include "renderer.h"
+#include "scene_file.h"
+#include "trace.h"
+#include "video_stream.h"
+
+using namespace std;
+
+struct BatchOptions {
+	string scene_fname = "scenes/default.scene";
+	string cameras_fname; // from the scene file when empty
+	int num_frames = 1500;
+	render_type rt = render_type::NOT_LIGHTED;
+	string output_dir;
+	tiff_compression compression = tiff_compression::NONE;
+	string stream_fname;
+	video_format stream_format = video_format::RAW_RGBA;
+	int fps = 30;
+	bool show_lights = false;
+	bool show_heatmap = false;
+	heatmap_metric heatmap_type = heatmap_metric::DEPTH_WRITES;
+	string trace_fname;
+};
+
+static bool parse_render_type(const char* name, render_type& rt) {
+	const char* names[] = { "lighted", "pixel_lighted", "not_lighted", "textured", "mirrored_textured", "mirror" };
+	const render_type types[] = { render_type::LIGHTED, render_type::PIXEL_LIGHTED, render_type::NOT_LIGHTED,
+		render_type::NORMAL_TILING_TEXTURED, render_type::MIRRORED_TILING_TEXTURED, render_type::MIRROR_ONLY };
+	for (int i = 0; i < 6; i++) {
+		if (strcmp(name, names[i]) == 0) {
+			rt = types[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+int main(int argc, char** argv) {
+	BatchOptions options;
+	for (int i = 1; i < argc; i++) {
+		bool has_value = i + 1 < argc;
+		if (strcmp(argv[i], "-scene") == 0 && has_value) {
+			options.scene_fname = argv[++i];
+		}
+		else if (strcmp(argv[i], "-cameras") == 0 && has_value) {
+			options.cameras_fname = argv[++i];
+		}
+		else if (strcmp(argv[i], "-frames") == 0 && has_value) {
+			options.num_frames = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-rt") == 0 && has_value) {
+			if (!parse_render_type(argv[++i], options.rt)) {
+				cerr << "ERROR: unknown render type " << argv[i] << endl;
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-o") == 0 && has_value) {
+			options.output_dir = argv[++i];
+		}
+		else if (strcmp(argv[i], "-compress") == 0 && has_value) {
+			if (!parse_tiff_compression(argv[++i], options.compression)) {
+				cerr << "ERROR: unknown compression " << argv[i] << endl;
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-raw") == 0 && has_value) {
+			options.stream_fname = argv[++i];
+			options.stream_format = video_format::RAW_RGBA;
+		}
+		else if (strcmp(argv[i], "-y4m") == 0 && has_value) {
+			options.stream_fname = argv[++i];
+			options.stream_format = video_format::Y4M;
+		}
+		else if (strcmp(argv[i], "-fps") == 0 && has_value) {
+			options.fps = max(1, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "-lights") == 0) {
+			options.show_lights = true;
+		}
+		else if (strcmp(argv[i], "-heatmap") == 0 && has_value) {
+			options.show_heatmap = true;
+			if (!parse_heatmap_metric(argv[++i], options.heatmap_type)) {
+				cerr << "ERROR: unknown heatmap metric " << argv[i] << endl;
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-trace") == 0 && has_value) {
+			options.trace_fname = argv[++i];
+		}
+		else {
+			cerr << "usage: BatchRenderer [-scene file] [-cameras file] [-frames n] [-rt type] [-o dir] [-compress type] [-raw file] [-y4m file] [-fps n] [-lights] [-trace file] [-heatmap metric]" << endl;
+			return 1;
+		}
+	}
+
+	PPC scene_ppc;
+	Renderer renderer(nullptr, &scene_ppc);
+	auto load_start = chrono::steady_clock::now();
+	if (!load_scene_file((char*)options.scene_fname.c_str(), &renderer, renderer.asset_loader, options.rt == render_type::PIXEL_LIGHTED))
+		return 1;
+	if (options.cameras_fname.empty())
+		options.cameras_fname = renderer.camera_path;
+
+	PPC* ppcs;
+	int num_ppcs = load_from_file(&ppcs, (char*)options.cameras_fname.c_str());
+	if (num_ppcs < 2) {
+		cerr << "ERROR: need at least two cameras in " << options.cameras_fname << endl;
+		return 1;
+	}
+
+	// Every frame should see the whole scene, not whatever finished loading so far
+	renderer.asset_loader->wait_all();
+	if (options.rt == render_type::MIRROR_ONLY && !renderer.cube_map) {
+		cerr << "ERROR: -rt mirror needs an environment in " << options.scene_fname << endl;
+		return 1;
+	}
+	double load_seconds = chrono::duration<double>(chrono::steady_clock::now() - load_start).count();
+
+	renderer.show_lights = options.show_lights;
+	renderer.show_heatmap = options.show_heatmap;
+	renderer.heatmap_type = options.heatmap_type;
+
+	if (!options.output_dir.empty() && !make_directory(options.output_dir)) {
+		cerr << "ERROR: cannot create directory " << options.output_dir << endl;
+		return 1;
+	}
+
+	VideoStream stream;
+	if (!options.stream_fname.empty() &&
+		!stream.open(options.stream_fname, options.stream_format, ppcs[0].w, ppcs[0].h, options.fps))
+		return 1;
+
+	long long tris_per_frame = 0;
+	for (int i = 0; i < renderer.num_tms; i++) {
+		tris_per_frame += renderer.tms[i].num_tris;
+	}
+
+	ImageWriter writer(options.compression);
+
+	// Frames render concurrently but reach the output in order
+	bool write_failed = false;
+	if (!options.trace_fname.empty()) {
+		tracer()->set_thread_name("main");
+		tracer()->start();
+	}
+	auto start = chrono::steady_clock::now();
+	int num_rendered = renderer.render_path(ppcs, num_ppcs, options.num_frames, options.rt, [&](int f, Image* image) {
+		if (!options.output_dir.empty()) {
+			char fname[512];
+			snprintf(fname, sizeof(fname), "%s/frame_%04d.tiff", options.output_dir.c_str(), f);
+			writer.write(fname, image);
+		}
+		if (stream.is_open() && !write_failed)
+			write_failed = !stream.write(image);
+	});
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	writer.flush();
+	double write_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() - seconds;
+
+	if (!options.trace_fname.empty()) {
+		tracer()->stop();
+		if (!tracer()->save(options.trace_fname))
+			return 1;
+	}
+
+	stream.close();
+	if (write_failed || writer.get_failed() > 0)
+		return 1;
+
+	// Report goes to cerr so the stream can go to stdout
+	cerr << "INFO: loaded assets in " << load_seconds * 1000.0 << " ms" << endl;
+	cerr << "INFO: rendered " << num_rendered << " frames of " << ppcs[0].w << "x" << ppcs[0].h << " in " << seconds << " s" << endl;
+	if (num_rendered > 0 && seconds > 0.0) {
+		cerr << "      " << num_rendered / seconds << " frames/s, " << seconds * 1000.0 / num_rendered << " ms/frame, "
+			<< (double)tris_per_frame * num_rendered / seconds / 1e6 << " Mtris/s" << endl;
+	}
+	if (!options.output_dir.empty()) {
+		cerr << "INFO: wrote " << writer.get_written() << " TIFFs, " << write_seconds * 1000.0 << " ms after the last frame, "
+			<< writer.get_max_queued() << " frames queued at most" << endl;
+	}
+	return 0;
+}
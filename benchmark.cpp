@@ -0,0 +1,316 @@
+// Deterministic rendering benchmark. Every bundled mesh is rendered along a fixed orbit in
+// every mode, with and without shadows and the environment, and the timings go out as JSON.
+//
+// usage: Benchmark [-frames n] [-warmup n] [-size w h] [-mesh name] [-mode name] [-o file.json]
+//   -frames timed frames per run (default 60), -warmup untimed frames before them (default 5)
+//   -mesh and -mode restrict the runs, e.g. -mesh teapot57K -mode pixel_lighted
+//   modes: lighted, pixel_lighted, unlit, textured, mirror, wireframe
+//
+// The orbit, light and resolution only depend on the mesh, so two runs of the same build
+// render identical frames; checksum is a hash of the last frame to catch output changes.
+// Builds with the profiler compiled in (debug, or GP_PROFILE=1) also report the average
+// per-frame stage times and pipeline counters of each run.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "asset_cache.h"
+#include "cube_map.h"
+#include "profiler.h"
+#include "renderer.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+struct BenchmarkOptions {
+	int num_frames = 60;
+	int num_warmup = 5;
+	int w = 640, h = 480;
+	string mesh_filter;
+	string mode_filter;
+	string output_fname; // stdout when empty
+};
+
+struct BenchmarkMode {
+	const char* name;
+	render_type rt;
+	bool lighted; // shadows only matter for these
+	bool needs_environment;
+	bool wireframe;
+};
+
+static const char* mesh_names[] = { "teapot1K", "teapot57K", "bunny", "happy4", "car", "tree1", "terrain" };
+
+static const BenchmarkMode modes[] = {
+	{ "lighted", render_type::LIGHTED, true, false, false },
+	{ "pixel_lighted", render_type::PIXEL_LIGHTED, true, false, false },
+	{ "unlit", render_type::NOT_LIGHTED, false, false, false },
+	{ "textured", render_type::NORMAL_TILING_TEXTURED, false, false, false },
+	{ "mirror", render_type::MIRROR_ONLY, false, true, false },
+	{ "wireframe", render_type::NOT_LIGHTED, false, false, true },
+};
+
+struct BenchmarkResult {
+	string mesh, mode;
+	bool shadows, environment;
+	int num_tris;
+	vector<double> frame_ms;
+	unsigned int checksum;
+	long long pixels_covered = 0; // sum over the timed frames, counted from the z-buffer outside the timing
+	FrameProfile profile; // sums over the timed frames
+};
+
+static unsigned int hash_pixels(const unsigned int* pix, int count) {
+	unsigned int hash = 2166136261u;
+	for (int i = 0; i < count; i++) {
+		hash = (hash ^ pix[i]) * 16777619u;
+	}
+	return hash;
+}
+
+// Pixels with geometry, the z-buffer is cleared to 0 (1/z); counted here rather than by the
+// profiler so release builds report it too
+static long long count_covered_pixels(Image& image) {
+	long long covered = 0;
+	for (int i = 0; i < image.w * image.h; i++) {
+		covered += image.zb[i] != 0.0f;
+	}
+	return covered;
+}
+
+static double percentile(vector<double> sorted_ms, double p) {
+	if (sorted_ms.empty())
+		return 0.0;
+	sort(sorted_ms.begin(), sorted_ms.end());
+	double index = p * (sorted_ms.size() - 1);
+	int lo = (int)floor(index);
+	int hi = min(lo + 1, (int)sorted_ms.size() - 1);
+	return sorted_ms[lo] + (sorted_ms[hi] - sorted_ms[lo]) * (index - lo);
+}
+
+// Planar texture coordinates over the x/y extent, .bin meshes do not keep theirs
+static V3* make_planar_tcs(TM& tm, V3 p1, V3 p2) {
+	V3* tcs = new V3[tm.num_verts];
+	float sx = 4.0f / fmaxf(p2[0] - p1[0], 1e-6f);
+	float sy = 4.0f / fmaxf(p2[1] - p1[1], 1e-6f);
+	for (int vi = 0; vi < tm.num_verts; vi++) {
+		V3 v = tm.get_vert(vi);
+		tcs[vi] = V3((v[0] - p1[0]) * sx, (v[1] - p1[1]) * sy, 0.0f);
+	}
+	return tcs;
+}
+
+// One full turn around the mesh, slightly from above, far enough to keep it in view
+static void make_orbit(V3 center, float radius, int num_frames, int w, int h, vector<PPC>& ppcs) {
+	const float hfov = 60.0f;
+	float distance = 1.3f * radius / tanf(hfov * 0.5f * 3.14159265f / 180.0f);
+	for (int f = 0; f < num_frames; f++) {
+		float angle = 2.0f * 3.14159265f * (float)f / (float)num_frames;
+		V3 eye = center + V3(sinf(angle) * distance, 0.35f * distance, cosf(angle) * distance);
+		PPC ppc(hfov, w, h);
+		ppc.pose(eye, center, V3(0.0f, 1.0f, 0.0f));
+		ppcs.push_back(ppc);
+	}
+}
+
+static void render_frame(Renderer& renderer, const BenchmarkMode& mode) {
+	if (!mode.wireframe) {
+		renderer.render(mode.rt);
+		return;
+	}
+	renderer.image->clear();
+	for (int i = 0; i < renderer.num_tms; i++) {
+		renderer.tms[i].render_as_wireframe(renderer.ppc, renderer.image, false);
+	}
+	if (renderer.cube_map)
+		renderer.cube_map->render_as_environment(renderer.ppc, renderer.image);
+	profiler()->end_frame(renderer.image);
+}
+
+static void write_json(FILE* out, const BenchmarkOptions& options, const vector<BenchmarkResult>& results) {
+	fprintf(out, "{\n");
+	fprintf(out, "  \"threads\": %d,\n", thread_pool()->num_workers() + 1);
+	fprintf(out, "  \"width\": %d,\n  \"height\": %d,\n", options.w, options.h);
+	fprintf(out, "  \"frames\": %d,\n  \"warmup\": %d,\n", options.num_frames, options.num_warmup);
+	fprintf(out, "  \"runs\": [");
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchmarkResult& r = results[i];
+		vector<double> sorted_ms = r.frame_ms;
+		sort(sorted_ms.begin(), sorted_ms.end());
+		double total_ms = 0.0;
+		for (double ms : sorted_ms) {
+			total_ms += ms;
+		}
+		double seconds = total_ms / 1000.0;
+		double frames = (double)sorted_ms.size();
+
+		fprintf(out, "%s\n    {\"mesh\": \"%s\", \"mode\": \"%s\", \"shadows\": %s, \"environment\": %s, \"triangles\": %d,\n",
+			i ? "," : "", r.mesh.c_str(), r.mode.c_str(), r.shadows ? "true" : "false", r.environment ? "true" : "false", r.num_tris);
+		fprintf(out, "     \"ms\": {\"min\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f, \"mean\": %.3f},\n",
+			sorted_ms.front(), percentile(sorted_ms, 0.5), percentile(sorted_ms, 0.9), percentile(sorted_ms, 0.99),
+			sorted_ms.back(), total_ms / frames);
+		fprintf(out, "     \"tris_per_s\": %.0f, \"pixels_per_s\": %.0f, \"pixels_covered\": %.0f, \"checksum\": \"%08x\"",
+			seconds > 0.0 ? r.num_tris * frames / seconds : 0.0, seconds > 0.0 ? (double)r.pixels_covered / seconds : 0.0,
+			(double)r.pixels_covered / frames, r.checksum);
+#if GP_PROFILE
+		fprintf(out, ",\n     \"stages_ms\": {");
+		for (int si = 0; si < (int)profile_stage::COUNT; si++) {
+			fprintf(out, "%s\"%s\": %.3f", si ? ", " : "", get_stage_name((profile_stage)si), r.profile.stage_ms[si] / frames);
+		}
+		fprintf(out, "},\n     \"counters\": {");
+		for (int ci = 0; ci < (int)profile_counter::COUNT; ci++) {
+			fprintf(out, "%s\"%s\": %.0f", ci ? ", " : "", get_counter_name((profile_counter)ci), r.profile.counters[ci] / frames);
+		}
+		fprintf(out, ", \"overdraw\": %.3f}", r.profile.get_overdraw());
+#endif
+		fprintf(out, "}");
+	}
+	fprintf(out, "\n  ]\n}\n");
+}
+
+int main(int argc, char** argv) {
+	BenchmarkOptions options;
+	for (int i = 1; i < argc; i++) {
+		bool has_value = i + 1 < argc;
+		if (strcmp(argv[i], "-frames") == 0 && has_value) {
+			options.num_frames = max(1, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "-warmup") == 0 && has_value) {
+			options.num_warmup = max(0, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "-size") == 0 && i + 2 < argc) {
+			options.w = max(1, atoi(argv[++i]));
+			options.h = max(1, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "-mesh") == 0 && has_value) {
+			options.mesh_filter = argv[++i];
+		}
+		else if (strcmp(argv[i], "-mode") == 0 && has_value) {
+			options.mode_filter = argv[++i];
+		}
+		else if (strcmp(argv[i], "-o") == 0 && has_value) {
+			options.output_fname = argv[++i];
+		}
+		else {
+			cerr << "usage: Benchmark [-frames n] [-warmup n] [-size w h] [-mesh name] [-mode name] [-o file.json]" << endl;
+			return 1;
+		}
+	}
+
+	FILE* out = stdout;
+	if (!options.output_fname.empty()) {
+		out = fopen(options.output_fname.c_str(), "w");
+		if (!out) {
+			cerr << "ERROR: cannot open " << options.output_fname << " for writing" << endl;
+			return 1;
+		}
+	}
+
+	Image image(options.w, options.h);
+	PPC scene_ppc(60.0f, options.w, options.h);
+	Renderer renderer(&image, &scene_ppc);
+	renderer.show_lights = false;
+
+	CubeMap* environment = new CubeMap((char*)"textures/uffizi_cross.tiff");
+	Image* texture = asset_cache()->acquire_texture("textures/bricks.tiff");
+
+	vector<BenchmarkResult> results;
+	for (const char* mesh_name : mesh_names) {
+		if (!options.mesh_filter.empty() && options.mesh_filter != mesh_name)
+			continue;
+
+		string fname = string("geometry/") + mesh_name + ".bin";
+		TM mesh((char*)fname.c_str());
+		if (mesh.num_tris <= 0) {
+			cerr << "ERROR: cannot load " << fname << ", skipped" << endl;
+			continue;
+		}
+
+		V3 p1, p2;
+		mesh.get_bounding_box(p1, p2);
+		V3 center = (p1 + p2) * 0.5f;
+		float radius = fmaxf((p2 - p1).length() * 0.5f, 1e-3f);
+		V3* tcs = make_planar_tcs(mesh, p1, p2);
+
+		vector<PPC> orbit;
+		make_orbit(center, radius, options.num_frames, options.w, options.h, orbit);
+
+		renderer.num_tms = 1;
+		renderer.tms = &mesh;
+		renderer.lights[0]->pos = center + V3(radius * 1.5f, radius * 2.0f, radius * 1.5f);
+
+		for (const BenchmarkMode& mode : modes) {
+			if (!options.mode_filter.empty() && options.mode_filter != mode.name)
+				continue;
+
+			bool textured = mode.rt == render_type::NORMAL_TILING_TEXTURED;
+			mesh.set_tex(textured ? texture : nullptr, textured ? tcs : nullptr);
+
+			for (int shadows = 0; shadows <= (mode.lighted ? 1 : 0); shadows++) {
+				for (int env = mode.needs_environment ? 1 : 0; env <= 1; env++) {
+					renderer.lights[0]->casts_shadows = shadows != 0;
+					renderer.cube_map = env ? environment : nullptr;
+					// Lighting reads the light position from the shadow map, runs without shadows
+					// must not see whatever position an earlier run or mesh left there
+					renderer.shadow_map->set_pos(renderer.lights[0]->pos);
+					// The light does not move, shadows are rendered once like the interactive renderer does
+					if (shadows)
+						renderer.render_shadows();
+
+					BenchmarkResult result;
+					result.mesh = mesh_name;
+					result.mode = mode.name;
+					result.shadows = shadows != 0;
+					result.environment = env != 0;
+					result.num_tris = mesh.num_tris;
+
+					for (int f = -options.num_warmup; f < options.num_frames; f++) {
+						renderer.ppc = &orbit[(f % options.num_frames + options.num_frames) % options.num_frames]; // warmup may exceed frames
+						auto start = chrono::steady_clock::now();
+						render_frame(renderer, mode);
+						double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+						if (f < 0)
+							continue;
+						result.frame_ms.push_back(ms);
+						result.pixels_covered += count_covered_pixels(image);
+
+						FrameProfile frame = profiler()->get_last_frame();
+						for (int si = 0; si < (int)profile_stage::COUNT; si++) {
+							result.profile.stage_ms[si] += frame.stage_ms[si];
+						}
+						for (int ci = 0; ci < (int)profile_counter::COUNT; ci++) {
+							result.profile.counters[ci] += frame.counters[ci];
+						}
+						result.profile.pixels_covered += frame.pixels_covered;
+					}
+					result.checksum = hash_pixels(image.pix, options.w * options.h);
+
+					cerr << "INFO: " << mesh_name << " " << mode.name << (shadows ? " shadows" : "") << (env ? " environment" : "")
+						<< ": " << percentile(result.frame_ms, 0.5) << " ms/frame" << endl;
+					results.push_back(result);
+				}
+			}
+		}
+
+		mesh.set_tex(nullptr, nullptr);
+		delete[] tcs;
+		mesh.release();
+	}
+	renderer.ppc = &scene_ppc;
+	renderer.tms = nullptr;
+	renderer.num_tms = 0;
+	renderer.cube_map = nullptr;
+	delete environment;
+	asset_cache()->release("textures/bricks.tiff");
+
+	write_json(out, options, results);
+	if (out != stdout)
+		fclose(out);
+	return 0;
+}
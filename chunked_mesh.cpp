@@ -0,0 +1,210 @@
+#include "chunked_mesh.h"
+#include "mesh_bake.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+
+bool write_chunked_mesh(char* fname, MeshData& mesh, int chunks_x, int chunks_z) {
+	int num_tris = mesh.num_tris();
+	if (mesh.num_verts() <= 0 || num_tris <= 0 || chunks_x <= 0 || chunks_z <= 0) {
+		cerr << "ERROR: cannot write empty chunked mesh to " << fname << endl;
+		return false;
+	}
+
+	bool has_colors = !mesh.colors.empty();
+	bool has_normals = !mesh.normals.empty();
+
+	ChunkedMeshHeader h = {};
+	h.magic = chunked_mesh_magic;
+	h.version = chunked_mesh_version;
+	h.header_size = sizeof(ChunkedMeshHeader);
+	h.flags = (has_colors ? (uint32_t)CHUNKED_MESH_COLORS : 0u) | (has_normals ? (uint32_t)CHUNKED_MESH_NORMALS : 0u);
+	h.chunks_x = (uint32_t)chunks_x;
+	h.chunks_z = (uint32_t)chunks_z;
+	h.num_chunks = (uint32_t)(chunks_x * chunks_z);
+
+	for (int i = 0; i < 3; i++) {
+		h.bounds_min[i] = FLT_MAX;
+		h.bounds_max[i] = -FLT_MAX;
+	}
+	for (V3& P : mesh.verts) {
+		for (int i = 0; i < 3; i++) {
+			h.bounds_min[i] = fminf(h.bounds_min[i], P[i]);
+			h.bounds_max[i] = fmaxf(h.bounds_max[i], P[i]);
+		}
+	}
+
+	// Each triangle goes to the chunk its centroid falls in
+	float cell_x = (h.bounds_max[0] - h.bounds_min[0]) / (float)chunks_x;
+	float cell_z = (h.bounds_max[2] - h.bounds_min[2]) / (float)chunks_z;
+	vector<vector<int>> chunk_tris(h.num_chunks);
+	for (int ti = 0; ti < num_tris; ti++) {
+		V3 centroid = (mesh.verts[mesh.tris[ti * 3 + 0]] + mesh.verts[mesh.tris[ti * 3 + 1]] +
+			mesh.verts[mesh.tris[ti * 3 + 2]]) * (1.0f / 3.0f);
+		int cx = (cell_x > 0.0f) ? (int)((centroid[0] - h.bounds_min[0]) / cell_x) : 0;
+		int cz = (cell_z > 0.0f) ? (int)((centroid[2] - h.bounds_min[2]) / cell_z) : 0;
+		cx = min(max(cx, 0), chunks_x - 1);
+		cz = min(max(cz, 0), chunks_z - 1);
+		chunk_tris[cz * chunks_x + cx].push_back(ti);
+	}
+
+	ofstream ofs(fname, ios::binary);
+	if (ofs.fail()) {
+		cerr << "ERROR: cannot open file for writing: " << fname << endl;
+		return false;
+	}
+
+	// Table goes right after the header, chunk data after the table
+	h.chunk_table_offset = sizeof(ChunkedMeshHeader);
+	vector<ChunkRecord> records(h.num_chunks);
+	ofs.write((const char*)&h, sizeof(h));
+	ofs.write((const char*)records.data(), records.size() * sizeof(ChunkRecord));
+
+	vector<int> remap(mesh.num_verts(), -1);
+	vector<V3> verts, colors, normals;
+	vector<unsigned int> tris;
+	for (uint32_t ci = 0; ci < h.num_chunks; ci++) {
+		verts.clear();
+		colors.clear();
+		normals.clear();
+		tris.clear();
+
+		for (int ti : chunk_tris[ci]) {
+			for (int k = 0; k < 3; k++) {
+				unsigned int vi = mesh.tris[ti * 3 + k];
+				if (remap[vi] < 0) {
+					remap[vi] = (int)verts.size();
+					verts.push_back(mesh.verts[vi]);
+					if (has_colors)
+						colors.push_back(mesh.colors[vi]);
+					if (has_normals)
+						normals.push_back(mesh.normals[vi]);
+				}
+				tris.push_back((unsigned int)remap[vi]);
+			}
+		}
+		for (int ti : chunk_tris[ci]) {
+			for (int k = 0; k < 3; k++) {
+				remap[mesh.tris[ti * 3 + k]] = -1;
+			}
+		}
+
+		ChunkRecord& r = records[ci];
+		for (int i = 0; i < 3; i++) {
+			r.bounds_min[i] = FLT_MAX;
+			r.bounds_max[i] = -FLT_MAX;
+		}
+		for (V3& P : verts) {
+			for (int i = 0; i < 3; i++) {
+				r.bounds_min[i] = fminf(r.bounds_min[i], P[i]);
+				r.bounds_max[i] = fmaxf(r.bounds_max[i], P[i]);
+			}
+		}
+		r.num_verts = (uint32_t)verts.size();
+		r.num_tris = (uint32_t)(tris.size() / 3);
+		r.offset = (uint64_t)ofs.tellp();
+
+		ofs.write((const char*)verts.data(), verts.size() * sizeof(V3));
+		ofs.write((const char*)colors.data(), colors.size() * sizeof(V3));
+		ofs.write((const char*)normals.data(), normals.size() * sizeof(V3));
+		ofs.write((const char*)tris.data(), tris.size() * sizeof(unsigned int));
+		r.size = (uint64_t)ofs.tellp() - r.offset;
+	}
+
+	ofs.seekp((streamoff)h.chunk_table_offset);
+	ofs.write((const char*)records.data(), records.size() * sizeof(ChunkRecord));
+
+	if (ofs.fail()) {
+		cerr << "ERROR: failed writing chunked mesh " << fname << endl;
+		return false;
+	}
+	return true;
+}
+
+bool ChunkedMeshFile::open(char* fname) {
+	name = fname;
+	ifs.open(fname, ios::binary);
+	if (ifs.fail()) {
+		cerr << "INFO: cannot open file: " << fname << endl;
+		return false;
+	}
+
+	ifs.read((char*)&header, sizeof(header));
+	if (ifs.fail() || header.magic != chunked_mesh_magic) {
+		cerr << "ERROR: file " << fname << " is not a chunked mesh" << endl;
+		return false;
+	}
+	if (header.version != chunked_mesh_version || header.header_size < sizeof(ChunkedMeshHeader)) {
+		cerr << "ERROR: chunked mesh " << fname << " has unsupported version " << header.version << endl;
+		return false;
+	}
+
+	ifs.seekg(0, ios::end);
+	uint64_t file_size = (uint64_t)ifs.tellg();
+	// The table has to fit in the file before its size is trusted for an allocation
+	if (header.chunk_table_offset > file_size ||
+		header.num_chunks > (file_size - header.chunk_table_offset) / sizeof(ChunkRecord)) {
+		cerr << "ERROR: chunked mesh " << fname << " is truncated" << endl;
+		return false;
+	}
+
+	chunks.resize(header.num_chunks);
+	ifs.seekg((streamoff)header.chunk_table_offset);
+	ifs.read((char*)chunks.data(), chunks.size() * sizeof(ChunkRecord));
+	if (ifs.fail()) {
+		cerr << "ERROR: chunked mesh " << fname << " is truncated" << endl;
+		return false;
+	}
+
+	uint64_t attributes = 1 + ((header.flags & CHUNKED_MESH_COLORS) ? 1 : 0) + ((header.flags & CHUNKED_MESH_NORMALS) ? 1 : 0);
+	for (size_t ci = 0; ci < chunks.size(); ci++) {
+		ChunkRecord& r = chunks[ci];
+		uint64_t expected_size = (uint64_t)r.num_verts * attributes * sizeof(V3) + (uint64_t)r.num_tris * 3 * sizeof(unsigned int);
+		if (r.size != expected_size || r.offset > file_size || r.size > file_size - r.offset) {
+			cerr << "ERROR: chunk " << ci << " of " << fname << " is corrupt" << endl;
+			chunks.clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+bool ChunkedMeshFile::read_chunk(int ci, V3*& verts, V3*& colors, V3*& normals, unsigned int*& tris) {
+	ChunkRecord& r = chunks[ci];
+	verts = new V3[r.num_verts];
+	colors = (header.flags & CHUNKED_MESH_COLORS) ? new V3[r.num_verts] : nullptr;
+	normals = (header.flags & CHUNKED_MESH_NORMALS) ? new V3[r.num_verts] : nullptr;
+	tris = new unsigned int[(size_t)r.num_tris * 3];
+
+	ifs.clear();
+	ifs.seekg((streamoff)r.offset);
+	ifs.read((char*)verts, (size_t)r.num_verts * sizeof(V3));
+	if (colors)
+		ifs.read((char*)colors, (size_t)r.num_verts * sizeof(V3));
+	if (normals)
+		ifs.read((char*)normals, (size_t)r.num_verts * sizeof(V3));
+	ifs.read((char*)tris, (size_t)r.num_tris * 3 * sizeof(unsigned int));
+
+	bool valid = !ifs.fail();
+	if (!valid)
+		cerr << "ERROR: failed reading chunk " << ci << " of " << name << endl;
+	for (uint64_t i = 0; valid && i < (uint64_t)r.num_tris * 3; i++) {
+		if (tris[i] >= r.num_verts) {
+			cerr << "ERROR: chunk " << ci << " of " << name << " has index " << tris[i] << " past the last vertex" << endl;
+			valid = false;
+		}
+	}
+
+	if (!valid) {
+		delete[] verts;
+		delete[] colors;
+		delete[] normals;
+		delete[] tris;
+		return false;
+	}
+	return true;
+}
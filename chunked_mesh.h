@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "v3.h"
+
+struct MeshData;
+
+// Chunked mesh file, .gpc files. The mesh is cut into a grid of chunks over its xz
+// bounds and each chunk is stored as a self contained mesh (its own vertices,
+// duplicated where chunks meet) so chunks can be read one at a time by StreamingMesh.
+
+const uint32_t chunked_mesh_magic = 0x43504723; // "#GPC"
+const uint32_t chunked_mesh_version = 1;
+
+enum chunked_mesh_flags : uint32_t {
+	CHUNKED_MESH_COLORS = 1 << 0,
+	CHUNKED_MESH_NORMALS = 1 << 1,
+};
+
+struct ChunkedMeshHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t header_size; // sizeof(ChunkedMeshHeader) of the writer
+	uint32_t flags;
+	uint32_t num_chunks;
+	uint32_t chunks_x, chunks_z;
+	uint32_t reserved;
+	float bounds_min[3];
+	float bounds_max[3];
+	uint64_t chunk_table_offset; // num_chunks ChunkRecords
+};
+
+// A chunk's data is verts, then colors and normals when the flags say so, all one V3
+// per vertex, then three unsigned int indices per triangle
+struct ChunkRecord {
+	float bounds_min[3];
+	float bounds_max[3];
+	uint32_t num_verts;
+	uint32_t num_tris;
+	uint64_t offset;
+	uint64_t size;
+};
+
+bool write_chunked_mesh(char* fname, MeshData& mesh, int chunks_x, int chunks_z);
+
+class ChunkedMeshFile {
+public:
+	ChunkedMeshHeader header;
+	std::vector<ChunkRecord> chunks;
+
+	bool open(char* fname); // only reads the header and the chunk table
+
+	// Allocates and fills the arrays of chunk ci, colors and normals are null when absent.
+	// Not thread safe, StreamingMesh only calls it from its I/O thread.
+	bool read_chunk(int ci, V3*& verts, V3*& colors, V3*& normals, unsigned int*& tris);
+
+private:
+	std::ifstream ifs;
+	std::string name;
+};
@@ -1,14 +1,30 @@
 #include "cube_map.h"
 #include "tiffio.h"
-#include "framebuffer.h"
+#include "image.h"
+#include "asset_cache.h"
+#include "heatmap.h"
+#include "profiler.h"
+#include "trace.h"
+
+#include <memory>
+#include <stdexcept>
 
 using namespace std;
 
 CubeMap::CubeMap(char* fname) {
-	//Only used to load tiff and set faces using FrameBuffer methods
-	FrameBuffer temp(0, 0, 1, 1);
-	temp.load_tiff(fname);
+	shared_ptr<const CachedImage> image = asset_cache()->get_image(fname);
+	if (!image) {
+		throw new runtime_error("Cube map image could not be loaded");
+	}
+
+	set_from_cross(image->pix, image->w, image->h);
+}
+
+CubeMap::CubeMap(const unsigned int* pix, int w, int h) {
+	set_from_cross(pix, w, h);
+}
 
+void CubeMap::set_from_cross(const unsigned int* pix, int w, int h) {
 	/* Assumes this layout for the faces in the image
 		[ ][0][ ]
 		[1][2][3]
@@ -16,21 +32,24 @@ CubeMap::CubeMap(char* fname) {
 		[ ][5][ ]
 	*/
 
-	int face_width = temp.w / 3;
-	if (temp.h / 4 != face_width) {
+	int face_width = w / 3;
+	if (h / 4 != face_width) {
 		throw new logic_error("Width of faces doesn't equal height of faces");
 	}
 	
 	initialize(face_width, face_width, V3(0.0f, 0.0f, 0.0f));
 
+	// Same addressing as Image::get, v counts rows from the top
+	auto get = [pix, w, h](int u, int v) { return pix[(h - 1 - v) * w + u]; };
+
 	for (int u = 0; u < face_width; u++) {
 		for (int v = 0; v < face_width; v++) {
-			faces[2]->set(u, v, temp.get(u + face_width, v));
-			faces[1]->set(u, v, temp.get(u, v + face_width));
-			faces[5]->set(u, v, temp.get(u + face_width, v + face_width));
-			faces[0]->set(u, v, temp.get(u + 2 * face_width, v + face_width));
-			faces[3]->set(u, v, temp.get(u + face_width, v + 2 * face_width));
-			faces[4]->set(u, face_width - 1 - v, temp.get(u + face_width, v + 3 * face_width));
+			faces[2]->set(u, v, get(u + face_width, v));
+			faces[1]->set(u, v, get(u, v + face_width));
+			faces[5]->set(u, v, get(u + face_width, v + face_width));
+			faces[0]->set(u, v, get(u + 2 * face_width, v + face_width));
+			faces[3]->set(u, v, get(u + face_width, v + 2 * face_width));
+			faces[4]->set(u, face_width - 1 - v, get(u + face_width, v + 3 * face_width));
 		}
 	}
 }
@@ -39,13 +58,20 @@ CubeMap::CubeMap(int w, int h, V3 light_pos) {
 	initialize(w, h, light_pos);
 }
 
+CubeMap::~CubeMap() {
+	for (int i = 0; i < 6; i++) {
+		delete faces[i];
+		delete ppcs[i];
+	}
+}
+
 void CubeMap::initialize(int w, int h, V3 pos) {
 	prev_face = 0;
 
 	for (int i = 0; i < 6; i++) {
 		ppcs[i] = new PPC(90.0f, w, h);
 		ppcs[i]->C = pos;
-		faces[i] = new FrameBuffer(0, 0, w, h);
+		faces[i] = new Image(w, h);
 		faces[i]->clear();
 	}
 
@@ -80,7 +106,8 @@ unsigned int CubeMap::get_color(V3 dir) {
 			int w = faces[idx]->w;
 			int h = faces[idx]->h;
 
-			if (x < 0.0f || y < 0.0f || x >= (float)(w) || y >= (float)(h)) {
+			// Written so NaNs, from zero length normals, fail it too
+			if (!(x >= 0.0f && y >= 0.0f && x < (float)(w) && y < (float)(h))) {
 				continue;
 			}
 
@@ -115,7 +142,11 @@ unsigned int CubeMap::get_color(V3 dir) {
 	return 0xFF0000FF; //Should never reach here
 }
 
-void CubeMap::render_as_environment(PPC* ppc, FrameBuffer* fb) {
+void CubeMap::render_as_environment(PPC* ppc, Image* fb) {
+	TraceScope trace("CubeMap::render_as_environment");
+	ProfileScope environment(profile_stage::ENVIRONMENT);
+	PixelCounter pixels;
+	Heatmap* heat = fb->heatmap;
 	for (int u = 0; u < fb->w; u++) {
 		for (int v = 0; v < fb->h; v++) {
 			if (fb->get_zb(u, v) != 0.0f) {
@@ -124,6 +155,9 @@ void CubeMap::render_as_environment(PPC* ppc, FrameBuffer* fb) {
 			V3 dir = ppc->c + (float)u * ppc->a + (float)v * ppc->b;
 			unsigned int color = get_color(dir);
 			fb->set(u, v, color);
+			pixels.shaded();
+			if (heat)
+				heat->shaded(u, v);
 		}
 	}
 }
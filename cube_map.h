@@ -2,25 +2,28 @@
 
 #include "ppc.h"
 
-class FrameBuffer;
+class Image;
 
 class CubeMap {
 public:
-	FrameBuffer* faces[6];
+	Image* faces[6];
 	PPC* ppcs[6];
 	int prev_face;
 
 	//Constructor for environment cube map, loads from one tiff image
 	CubeMap(char* fname);
+	CubeMap(const unsigned int* pix, int w, int h); // from an already decoded cross image, see read_tiff_rgba
 
 	//Constructor for shadow map cube map
 	CubeMap(int w, int h, V3 light_pos);
+	~CubeMap();
 
 	unsigned int get_color(V3 dir);
 
-	void render_as_environment(PPC* ppc, FrameBuffer* fb);
+	void render_as_environment(PPC* ppc, Image* fb);
 
 private:
 	void initialize(int w, int h, V3 pos);
+	void set_from_cross(const unsigned int* pix, int w, int h);
 };
 
@@ -0,0 +1,195 @@
+#include "directional_shadow_map.h"
+#include "tm.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+DirectionalShadowMap::DirectionalShadowMap(int _size, int _num_cascades, V3 _dir) {
+	size = _size;
+	num_cascades = max(1, min((int)max_cascades, _num_cascades));
+	set_dir(_dir);
+
+	for (int i = 0; i < max_cascades; i++) {
+		ppcs[i] = new PPC();
+		depths[i] = (i < num_cascades) ? new float[size * size] : nullptr;
+		texel_sizes[i] = 0.0f;
+	}
+	for (int i = 0; i <= max_cascades; i++) {
+		split_depths[i] = 0.0f;
+	}
+
+	clear();
+}
+
+void DirectionalShadowMap::set_dir(V3 new_dir) {
+	dir = new_dir.normalized();
+}
+
+void DirectionalShadowMap::fit_cascades(PPC* ppc, float near_d, float far_d, V3 scene_min, V3 scene_max) {
+	eye_C = ppc->C;
+	eye_vd = ppc->get_vd();
+
+	near_d = fmaxf(near_d, 1e-3f);
+	far_d = fmaxf(far_d, near_d + 1.0f);
+
+	// Practical split scheme, a blend of logarithmic and uniform splits
+	const float lambda = 0.75f;
+	for (int i = 0; i <= num_cascades; i++) {
+		float t = (float)i / (float)num_cascades;
+		float log_d = near_d * powf(far_d / near_d, t);
+		float uniform_d = near_d + (far_d - near_d) * t;
+		split_depths[i] = lambda * log_d + (1.0f - lambda) * uniform_d;
+	}
+
+	// Light space basis with la ^ lb == dir, so get_vd() of the cascade cameras is dir
+	V3 up = (fabsf(dir[1]) < 0.99f) ? V3(0.0f, 1.0f, 0.0f) : V3(1.0f, 0.0f, 0.0f);
+	V3 la = (up ^ dir).normalized();
+	V3 lb = dir ^ la;
+
+	// Casters can be anywhere in the scene between the light and a slice
+	float scene_zmin = FLT_MAX;
+	for (int i = 0; i < 8; i++) {
+		V3 corner((i & 1) ? scene_max[0] : scene_min[0],
+			(i & 2) ? scene_max[1] : scene_min[1],
+			(i & 4) ? scene_max[2] : scene_min[2]);
+		scene_zmin = fminf(scene_zmin, corner * dir);
+	}
+
+	// Rays through the image corners, scaled so their view depth is 1
+	V3 corner_rays[4];
+	for (int i = 0; i < 4; i++) {
+		float u = (i & 1) ? (float)ppc->w : 0.0f;
+		float v = (i & 2) ? (float)ppc->h : 0.0f;
+		V3 ray = ppc->c + u * ppc->a + v * ppc->b;
+		corner_rays[i] = ray / (ray * eye_vd);
+	}
+
+	for (int ci = 0; ci < num_cascades; ci++) {
+		float xmin = FLT_MAX, ymin = FLT_MAX, zmin = FLT_MAX;
+		float xmax = -FLT_MAX, ymax = -FLT_MAX;
+
+		for (int si = ci; si <= ci + 1; si++) {
+			for (int i = 0; i < 4; i++) {
+				V3 P = eye_C + corner_rays[i] * split_depths[si];
+				float x = P * la;
+				float y = P * lb;
+				xmin = fminf(xmin, x);
+				xmax = fmaxf(xmax, x);
+				ymin = fminf(ymin, y);
+				ymax = fmaxf(ymax, y);
+				zmin = fminf(zmin, P * dir);
+			}
+		}
+		zmin = fminf(zmin, scene_zmin);
+
+		// Square texels, one spare texel so snapping the origin never crops the slice
+		float extent = fmaxf(xmax - xmin, ymax - ymin);
+		float texel = fmaxf(extent / (float)(size - 1), 1e-6f);
+
+		// Snap to whole texels so shadow edges do not shimmer while the camera moves
+		xmin = floorf(xmin / texel) * texel;
+		ymin = floorf(ymin / texel) * texel;
+
+		V3 corner = la * xmin + lb * ymin + dir * (zmin - 1.0f);
+		ppcs[ci]->set_orthographic(corner, la * texel, lb * texel, dir, size, size);
+		texel_sizes[ci] = texel;
+	}
+}
+
+void DirectionalShadowMap::clear() {
+	for (int ci = 0; ci < num_cascades; ci++) {
+		float* zb = depths[ci];
+		for (int i = 0; i < size * size; i++) {
+			zb[i] = FLT_MAX;
+		}
+	}
+}
+
+void DirectionalShadowMap::rasterize_depth(int cascade, V3 V0, V3 V1, V3 V2) {
+	float* zb = depths[cascade];
+
+	// Distances along dir interpolate linearly in an orthographic image
+	float d0 = 1.0f / V0[2];
+	float d1 = 1.0f / V1[2];
+	float d2 = 1.0f / V2[2];
+
+	float area = (V1[0] - V0[0]) * (V2[1] - V0[1]) - (V1[1] - V0[1]) * (V2[0] - V0[0]);
+	if (area == 0.0f)
+		return;
+
+	int left = max(0, (int)floorf(fminf(fminf(V0[0], V1[0]), V2[0])));
+	int right = min(size - 1, (int)ceilf(fmaxf(fmaxf(V0[0], V1[0]), V2[0])));
+	int top = max(0, (int)floorf(fminf(fminf(V0[1], V1[1]), V2[1])));
+	int bottom = min(size - 1, (int)ceilf(fmaxf(fmaxf(V0[1], V1[1]), V2[1])));
+
+	for (int v = top; v <= bottom; v++) {
+		float pv = (float)v + .5f;
+		for (int u = left; u <= right; u++) {
+			float pu = (float)u + .5f;
+
+			float w0 = ((V2[0] - V1[0]) * (pv - V1[1]) - (V2[1] - V1[1]) * (pu - V1[0])) / area;
+			float w1 = ((V0[0] - V2[0]) * (pv - V2[1]) - (V0[1] - V2[1]) * (pu - V2[0])) / area;
+			float w2 = 1.0f - w0 - w1;
+			if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+				continue;
+
+			float d = w0 * d0 + w1 * d1 + w2 * d2;
+			float& stored = zb[v * size + u];
+			if (d < stored)
+				stored = d;
+		}
+	}
+}
+
+void DirectionalShadowMap::add_tm(TM* tm) {
+	// Cascades are independent depth targets, render them in parallel
+	thread_pool()->parallel_for(num_cascades, 1, [this, tm](int begin, int end) {
+		TraceScope trace("DirectionalShadowMap::add_tm cascade");
+		vector<V3> projected(tm->num_verts);
+		vector<char> valid(tm->num_verts);
+
+		for (int ci = begin; ci < end; ci++) {
+			for (int vi = 0; vi < tm->num_verts; vi++) {
+				valid[vi] = (char)ppcs[ci]->project(tm->get_vert(vi), projected[vi]);
+			}
+
+			for (int ti = 0; ti < tm->num_tris; ti++) {
+				unsigned int v0 = tm->get_index(ti * 3 + 0);
+				unsigned int v1 = tm->get_index(ti * 3 + 1);
+				unsigned int v2 = tm->get_index(ti * 3 + 2);
+				if (!valid[v0] || !valid[v1] || !valid[v2])
+					continue;
+				rasterize_depth(ci, projected[v0], projected[v1], projected[v2]);
+			}
+		}
+	});
+}
+
+bool DirectionalShadowMap::in_shadow(V3 P) {
+	float d = (P - eye_C) * eye_vd;
+	if (d >= split_depths[num_cascades])
+		return false;
+
+	int ci = 0;
+	while (ci < num_cascades - 1 && d >= split_depths[ci + 1]) {
+		ci++;
+	}
+
+	V3 PP;
+	if (!ppcs[ci]->project(P, PP))
+		return false;
+
+	int u = (int)PP[0];
+	int v = (int)PP[1];
+	if (u < 0 || u > size - 1 || v < 0 || v > size - 1)
+		return false;
+
+	// Bias grows with the texel footprint to avoid self shadowing acne
+	return 1.0f / PP[2] > depths[ci][v * size + u] + 2.0f * texel_sizes[ci];
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "ppc.h"
+
+class TM; // Forward declaration
+
+// Cascaded shadow map for a directional light. Each cascade is one orthographic depth
+// target fitted to a depth slice of the camera frustum, nearer slices get smaller
+// boxes and so more shadow texels per world unit.
+class DirectionalShadowMap {
+public:
+	static const int max_cascades = 4;
+
+	int size; // width and height of each cascade
+	int num_cascades;
+	V3 dir; // direction the light travels in, normalized
+
+	PPC* ppcs[max_cascades]; // orthographic light cameras
+	float* depths[max_cascades]; // distance from each ppc's image plane, smaller is closer
+	float texel_sizes[max_cascades];
+	float split_depths[max_cascades + 1]; // camera depth range of cascade i is [split_depths[i], split_depths[i + 1])
+
+	V3 eye_C, eye_vd; // camera the cascades were last fitted to
+
+	DirectionalShadowMap(int _size, int _num_cascades, V3 _dir);
+
+	void set_dir(V3 new_dir);
+
+	// Splits [near_d, far_d] of ppc's view depth and fits one box per slice, extended
+	// toward the light to scene_min/scene_max so off screen casters are kept
+	void fit_cascades(PPC* ppc, float near_d, float far_d, V3 scene_min, V3 scene_max);
+
+	void clear();
+	void add_tm(TM* tm); // rasterizes the triangles of tm into every cascade
+
+	bool in_shadow(V3 P);
+
+private:
+	void rasterize_depth(int cascade, V3 V0, V3 V1, V3 V2);
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+// 5x7 bitmap font for text drawn into images (Image::draw_text). Covers the digits, upper case
+// letters and common punctuation, lower case letters use the upper case glyphs.
+const int glyph_w = 5;
+const int glyph_h = 7;
+const int glyph_advance = glyph_w + 1; // one column of spacing between characters
+
+// glyph_h rows, top first, bit 4 is the leftmost column; null for characters without a glyph
+const unsigned char* get_glyph(char c);
@@ -0,0 +1,81 @@
+#include "heatmap.h"
+#include "image.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+const char* get_heatmap_metric_name(heatmap_metric metric) {
+	const char* names[] = { "depth tests", "depth writes", "shader invocations" };
+	return names[(int)metric];
+}
+
+bool parse_heatmap_metric(const char* name, heatmap_metric& metric) {
+	const char* names[] = { "tests", "writes", "shaded" };
+	for (int i = 0; i < (int)heatmap_metric::COUNT; i++) {
+		if (strcmp(name, names[i]) == 0) {
+			metric = (heatmap_metric)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+Heatmap::Heatmap(int _w, int _h) {
+	w = _w;
+	h = _h;
+	tests.resize(w * h);
+	writes.resize(w * h);
+	shades.resize(w * h);
+}
+
+void Heatmap::clear() {
+	fill(tests.begin(), tests.end(), 0u);
+	fill(writes.begin(), writes.end(), 0u);
+	fill(shades.begin(), shades.end(), 0u);
+}
+
+vector<unsigned int>& Heatmap::get_counts(heatmap_metric metric) {
+	if (metric == heatmap_metric::DEPTH_WRITES)
+		return writes;
+	if (metric == heatmap_metric::SHADER_INVOCATIONS)
+		return shades;
+	return tests;
+}
+
+unsigned int Heatmap::get(heatmap_metric metric, int u, int v) {
+	return get_counts(metric)[index(u, v)];
+}
+
+long long Heatmap::get_total(heatmap_metric metric) {
+	long long total = 0;
+	for (unsigned int count : get_counts(metric)) {
+		total += count;
+	}
+	return total;
+}
+
+void Heatmap::draw(Image* image, heatmap_metric metric, int max_count) {
+	// One color per count, looked up instead of interpolated per pixel
+	V3 stops[] = { V3(0.0f, 0.0f, 1.0f), V3(0.0f, 1.0f, 1.0f), V3(0.0f, 1.0f, 0.0f),
+		V3(1.0f, 1.0f, 0.0f), V3(1.0f, 0.0f, 0.0f), V3(1.0f, 1.0f, 1.0f) };
+	const int num_stops = sizeof(stops) / sizeof(stops[0]);
+
+	max_count = max(2, max_count);
+	vector<unsigned int> ramp(max_count + 1);
+	ramp[0] = 0xFF000000;
+	for (int count = 1; count <= max_count; count++) {
+		float t = (float)(count - 1) / (float)(max_count - 1) * (num_stops - 1);
+		int i = min((int)t, num_stops - 2);
+		float f = t - (float)i;
+		V3 color = stops[i] * (1.0f - f) + stops[i + 1] * f;
+		ramp[count] = color.convert_to_color_int();
+	}
+
+	vector<unsigned int>& counts = get_counts(metric);
+	int n = min(w * h, image->w * image->h);
+	for (int i = 0; i < n; i++) {
+		image->pix[i] = ramp[min(counts[i], (unsigned int)max_count)];
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+
+class Image;
+
+enum class heatmap_metric {
+	DEPTH_TESTS, // pixels of a triangle that reached the depth test
+	DEPTH_WRITES, // passed it and were written, 1 means every pixel was drawn once
+	SHADER_INVOCATIONS, // colors computed, including the ones thrown away by the depth test
+	COUNT
+};
+
+const char* get_heatmap_metric_name(heatmap_metric metric);
+bool parse_heatmap_metric(const char* name, heatmap_metric& metric); // tests, writes or shaded
+
+// Per-pixel work of one frame, filled in by the rasterizers and the environment pass while an
+// Image has one attached (Image::set_heatmap) and drawn over the frame afterwards.
+class Heatmap {
+public:
+	int w, h;
+
+	Heatmap(int _w, int _h);
+
+	void clear();
+
+	// Image coordinates, v up like Image::set
+	void tested(int u, int v) { tests[index(u, v)]++; }
+	void written(int u, int v) { writes[index(u, v)]++; }
+	void shaded(int u, int v) { shades[index(u, v)]++; }
+
+	unsigned int get(heatmap_metric metric, int u, int v);
+	long long get_total(heatmap_metric metric);
+
+	// Replaces the colors of image with metric mapped to a ramp: black for 0, blue for 1, then
+	// cyan, green, yellow and red up to white at max_count or more
+	void draw(Image* image, heatmap_metric metric, int max_count = 8);
+
+private:
+	std::vector<unsigned int> tests, writes, shades; // laid out like Image::pix
+
+	int index(int u, int v) { return (h - 1 - v) * w + u; }
+	std::vector<unsigned int>& get_counts(heatmap_metric metric);
+};
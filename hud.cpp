@@ -0,0 +1,91 @@
+#include "hud.h"
+#include "image.h"
+#include "font.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+Hud::Hud(int _window) {
+	window = max(1, _window);
+	next = 0;
+	last_ms = 0.0;
+	last_interval_ms = 0.0;
+}
+
+void Hud::add_frame(double ms, double interval_ms) {
+	if ((int)frame_ms.size() < window)
+		frame_ms.push_back(ms);
+	else
+		frame_ms[next] = ms;
+	next = (next + 1) % window;
+	last_ms = ms;
+	last_interval_ms = interval_ms;
+}
+
+double Hud::get_percentile(double p) {
+	if (frame_ms.empty())
+		return 0.0;
+	vector<double> sorted = frame_ms;
+	size_t i = min(sorted.size() - 1, (size_t)(p * (double)(sorted.size() - 1) + .5));
+	nth_element(sorted.begin(), sorted.begin() + i, sorted.end());
+	return sorted[i];
+}
+
+void Hud::draw(Image* image, const FrameProfile& profile, long long num_tris) {
+	char line[128];
+	string text;
+
+	double fps = last_interval_ms > 0.0 ? 1000.0 / last_interval_ms : 0.0;
+	snprintf(line, sizeof(line), "frame %.2f ms  %.1f fps\n", last_ms, fps);
+	text += line;
+	snprintf(line, sizeof(line), "p50 %.2f ms  p99 %.2f ms  (%d frames)\n",
+		get_percentile(.5), get_percentile(.99), (int)frame_ms.size());
+	text += line;
+	snprintf(line, sizeof(line), "tris %lld\n", num_tris);
+	text += line;
+
+#if GP_PROFILE
+	for (int i = 1; i < (int)profile_stage::COUNT; i++) {
+		snprintf(line, sizeof(line), "%-14s %6.2f ms\n", get_stage_name((profile_stage)i), profile.stage_ms[i]);
+		text += line;
+	}
+	snprintf(line, sizeof(line), "submitted %lld  drawn %lld  culled %lld\n",
+		profile.get(profile_counter::TRIANGLES_SUBMITTED), profile.get(profile_counter::TRIANGLES_RASTERIZED),
+		profile.get(profile_counter::TRIANGLES_CULLED));
+	text += line;
+	snprintf(line, sizeof(line), "pixels shaded %lld  overdraw %.2f",
+		profile.get(profile_counter::PIXELS_SHADED), profile.get_overdraw());
+	text += line;
+#else
+	(void)profile; // empty without GP_PROFILE
+	text += "stages need a GP_PROFILE build";
+#endif
+
+	int num_lines = 1;
+	int max_chars = 0, chars = 0;
+	for (char c : text) {
+		if (c == '\n') {
+			num_lines++;
+			chars = 0;
+			continue;
+		}
+		max_chars = max(max_chars, ++chars);
+	}
+
+	// Darkened box behind the text so it reads over any scene
+	const int margin = 4;
+	int box_w = min(image->w, max_chars * glyph_advance + 2 * margin);
+	int box_h = min(image->h, num_lines * (glyph_h + 2) + 2 * margin);
+	for (int v = 0; v < box_h; v++) {
+		for (int u = 0; u < box_w; u++) {
+			unsigned int color = image->get(u, v);
+			image->set(u, v, 0xFF000000 | ((color >> 2) & 0x003F3F3F));
+		}
+	}
+
+	image->draw_text(margin, margin, text.c_str(), 0xFFFFFFFF);
+}
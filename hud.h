@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+
+#include "profiler.h"
+
+class Image;
+
+// Frame statistics drawn over the software frame, for watching a scene while tuning it: the
+// last frame time and rate, p50/p99 over the recent frames, and the stage times and triangle
+// and pixel counts of the profiler (those need a GP_PROFILE build).
+class Hud {
+public:
+	Hud(int _window = 240);
+
+	// ms is the render time of the frame, interval_ms the time since the frame before it
+	void add_frame(double ms, double interval_ms);
+	double get_percentile(double p); // of the render times in the window, p in [0, 1]
+
+	// num_tris is the triangle count of the scene, shown above the per-frame profiler counts
+	void draw(Image* image, const FrameProfile& profile, long long num_tris);
+
+private:
+	int window;
+	std::vector<double> frame_ms; // ring buffer of the last window render times
+	int next;
+	double last_ms, last_interval_ms;
+};
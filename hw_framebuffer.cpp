@@ -107,7 +107,15 @@ void HWFrameBuffer::init_textures() {
 		has_textures = true;
 		glEnable(GL_TEXTURE_2D);
 
+		// Textures come from the asset cache and are shared between meshes, upload each once
+		auto uploaded = texture_ids.find(tm->tex);
+		if (uploaded != texture_ids.end()) {
+			tm->tex_id = uploaded->second;
+			continue;
+		}
+
 		glGenTextures(1, &tm->tex_id);
+		texture_ids[tm->tex] = tm->tex_id;
 		glBindTexture(GL_TEXTURE_2D, tm->tex_id);
 
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -182,7 +190,7 @@ void HWFrameBuffer::init_environment_map() {
 	};
 
 	for (int i = 0; i < 6; i++) {
-		FrameBuffer* face = env_map->faces[i];
+		Image* face = env_map->faces[i];
 		unsigned char* pixelData;
 		if (i == 2 || i == 3)
 			pixelData = (unsigned char*)face->pix;
@@ -218,6 +226,14 @@ void HWFrameBuffer::set_tms(TM* tms, int num_tms) {
 	for (int i = 0; i < num_tms; i++)
 		tm_is_reflector[i] = false;
 
+	tms_changed();
+}
+
+void HWFrameBuffer::tms_changed() {
+	// vertex arrays are handed to OpenGL as floats
+	for (int i = 0; i < num_tms; i++)
+		tms[i].dequantize();
+
 	initialized = false;
 }
 
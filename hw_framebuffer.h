@@ -5,6 +5,7 @@
 #include "CGInterface.h"
 
 #include <chrono>
+#include <map>
 #include <FL/Fl_Box.H>
 
 struct Billboard {
@@ -37,6 +38,7 @@ public:
 	bool environment_map_enabled;
 
 	bool initialized;
+	std::map<Image*, GLuint> texture_ids; // uploaded textures, kept across init calls
 	bool billboards_initialized;
 
 	bool render_wireframe;
@@ -64,6 +66,7 @@ public:
 	void init_environment_map();
 
 	void set_tms(TM* tms, int num_tms);
+	void tms_changed(); // call after meshes or textures of tms were replaced, they are uploaded again on the next draw
 	void set_lighting(V3 light_pos);
 	void set_shadow_map(V3 light_pos, int shadow_map_size);
 	void set_environment_map(CubeMap* cube_map);
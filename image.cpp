@@ -0,0 +1,898 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+#include "image.h"
+#include "image_io.h"
+#include "font.h"
+#include "heatmap.h"
+#include "asset_cache.h"
+#include "cube_map.h"
+#include "lighting.h"
+#include "light.h"
+#include "profiler.h"
+
+using namespace std;
+
+// Rows start on cache line boundaries when w is a multiple of 16
+static const size_t image_alignment = 64;
+
+static void* alloc_aligned(size_t bytes) {
+#ifdef _WIN32
+	return _aligned_malloc(bytes, image_alignment);
+#else
+	return aligned_alloc(image_alignment, (bytes + image_alignment - 1) / image_alignment * image_alignment);
+#endif
+}
+
+static void free_aligned(void* p) {
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+Image::Image(int _w, int _h, bool with_depth) {
+	pix = nullptr;
+	zb = nullptr;
+	heatmap = nullptr;
+	w = 0;
+	h = 0;
+	allocate(_w, _h, with_depth);
+}
+
+Image::~Image() {
+	free_aligned(pix);
+	free_aligned(zb);
+	delete heatmap;
+}
+
+void Image::allocate(int _w, int _h, bool with_depth) {
+	free_aligned(pix);
+	free_aligned(zb);
+	w = _w;
+	h = _h;
+	size_t n = (size_t)max(1, w * h);
+	pix = (unsigned int*)alloc_aligned(n * sizeof(unsigned int));
+	zb = with_depth ? (float*)alloc_aligned(n * sizeof(float)) : nullptr;
+	if (heatmap) {
+		delete heatmap;
+		heatmap = new Heatmap(w, h);
+	}
+}
+
+void Image::set_heatmap(bool enabled) {
+	if (enabled && !heatmap)
+		heatmap = new Heatmap(w, h);
+	else if (!enabled) {
+		delete heatmap;
+		heatmap = nullptr;
+	}
+}
+
+// load a tiff image to pixel buffer
+void Image::load_tiff(char* fname) {
+	// Mapped from the pre-decoded .gpt after the first load, see AssetCache
+	shared_ptr<const CachedImage> image = asset_cache()->get_image(fname);
+	if (!image)
+		return;
+
+	set_pixels(image->w, image->h, image->pix);
+}
+
+void Image::set_pixels(int width, int height, const unsigned int* src) {
+	if (w != width || h != height)
+		allocate(width, height, zb != nullptr);
+
+	memcpy(pix, src, sizeof(unsigned int) * w * h);
+}
+
+// save as tiff image
+void Image::save_as_tiff(char *fname) {
+	if (!write_tiff_rgba(fname, pix, w, h))
+		throw new runtime_error("TIFF file could not be found");
+}
+
+void Image::clear() {
+	for (int uv = 0; uv < w * h; uv++) {
+		pix[uv] = 0xFFFFFFFF;
+	}
+	if (heatmap)
+		heatmap->clear();
+	if (!zb)
+		return;
+	for (int uv = 0; uv < w * h; uv++) {
+		zb[uv] = 0.0f;
+	}
+}
+
+void Image::set(unsigned int color) {
+	for (int uv = 0; uv < w*h; uv++)
+		pix[uv] = color;
+}
+
+void Image::set_zb(float z) {
+	for (int uv = 0; uv < w * h; uv++) {
+		zb[uv] = z;
+	}
+}
+
+
+void Image::set(int u, int v, unsigned int color) {
+	pix[(h - 1 - v) * w + u] = color;
+}
+
+void Image::set_zb(int u, int v, float z) {
+	zb[(h - 1 - v) * w + u] = z;
+}
+
+void Image::set_safe(int u, int v, unsigned int color) {
+	if (u < 0 || u > w - 1 || v < 0 || v > h - 1) return;
+	set(u, v, color);
+}
+
+void Image::set_zb_safe(int u, int v, float z) {
+	if (u < 0 || u > w - 1 || v < 0 || v > h - 1) return;
+	set_zb(u, v, z);
+}
+
+bool Image::set_with_zb(int u, int v, unsigned int color, float z) {
+	if (is_farther(u, v, z)) return false;
+	set(u, v, color);
+	set_zb(u, v, z);
+	return true;
+}
+
+void Image::set_with_zb_safe(int u, int v, unsigned int color, float z) {
+	if (u < 0 || u > w - 1 || v < 0 || v > h - 1) return;
+	set_with_zb(u, v, color, z);
+}
+
+unsigned int Image::get(int u, int v) {
+	return pix[(h - 1 - v) * w + u];
+}
+
+unsigned int Image::get(float tu, float tv) {
+	int u = (int)(tu * (w - 1));
+	int v = (int)(tv * (h - 1));
+	return get(u, v);
+}
+
+float Image::get_zb(int u, int v) {
+	return zb[(h - 1 - v) * w + u];
+}
+
+bool Image::is_farther(int u, int v, float z) {
+	return get_zb(u, v) > z;
+}
+
+bool Image::is_farther_safe(int u, int v, float z) {
+	if (u < 0 || u > w - 1 || v < 0 || v > h - 1) return false;
+	return is_farther(u, v, z);
+}
+
+void Image::draw_rectangle(int u, int v, int width, int height, unsigned int color) {
+	if (u < 0 || u + width > w - 1 || 
+		v < 0 || v + height > h - 1) return;
+
+	for (int uc = u; uc < u + width; uc++) {
+		for (int vc = v; vc < v + height; vc++) {
+			set(uc, vc, color);
+		}
+	}
+}
+
+void Image::draw_line(int u1, int v1, int u2, int v2, unsigned int color) {
+	//Ensure first point is to the left of second point
+	if (u1 > u2) {
+		swap(u1, u2);
+		swap(v1, v2);
+	}
+
+	if (u1 == u2) {
+		if (v1 > v2) {
+			swap(v1, v2);
+		}
+		for (int v = v1; v <= v2; v++) {
+			set(u1, v, color);
+		}
+	}
+	else if (v1 == v2) {
+		for (int u = u1; u <= u2; u++) {
+			set(u, v1, color);
+		}
+	}
+	else {
+		int du = u2 - u1;
+		int dv = v2 - v1;
+
+		if (abs(du) >= abs(dv)) {
+			double slope = (double)dv / (double)du;
+			double v = v1;
+			for (int u = u1; u <= u2; u++) {
+				set(u, (int)(v + .5), color);
+				v += slope;
+			}
+		}
+		else {
+			if (v1 > v2) {
+				swap(u1, u2);
+				swap(v1, v2);
+			}
+			double slope = (double)du / (double)dv;
+			double u = u1;
+			for (int v = v1; v <= v2; v++) {
+				set((int)(u + .5), v, color);
+				u += slope;
+			}
+		}
+	}
+} 
+
+void Image::draw_line_safe(int u1, int v1, int u2, int v2, unsigned int color) {
+	if (u1 < 0 || u1 > w - 1 || v1 < 0 || v1 > h - 1) return;
+	if (u2 < 0 || u2 > w - 1 || v2 < 0 || v2 > h - 1) return;
+	draw_line(u1, v1, u2, v2, color);
+}
+void Image::draw_circle(int u, int v, int radius, unsigned int color) {
+	if (u - radius < 0 || u + radius > w - 1 ||
+		v - radius < 0 || v + radius > h - 1) return;
+
+	for (int uc = -radius; uc <= radius; uc++) {
+		for (int vc = -radius; vc <= radius; vc++) {
+			if (uc * uc + vc * vc <= radius * radius) {
+				set(u + uc, v + vc, color);
+			}
+		}
+	}
+}
+
+void Image::draw_text(int u, int v, const char* text, unsigned int color, int scale) {
+	int pen_u = u;
+	for (const char* c = text; *c; c++) {
+		if (*c == '\n') {
+			pen_u = u;
+			v += (glyph_h + 2) * scale;
+			continue;
+		}
+
+		const unsigned char* glyph = get_glyph(*c);
+		if (glyph) {
+			for (int row = 0; row < glyph_h; row++) {
+				for (int col = 0; col < glyph_w; col++) {
+					if (!(glyph[row] & (0x10 >> col)))
+						continue;
+					for (int dv = 0; dv < scale; dv++) {
+						for (int du = 0; du < scale; du++) {
+							set_safe(pen_u + col * scale + du, v + row * scale + dv, color);
+						}
+					}
+				}
+			}
+		}
+		pen_u += glyph_advance * scale;
+	}
+}
+
+void Image::draw_2d_point(V3 P, int psize, unsigned int color) {
+	int up = (int)P[0];
+	int vp = (int)P[1];
+
+	for (int u = up - psize / 2; u < up + psize / 2; u++) {
+		for (int v = vp - psize / 2; v < vp + psize / 2; v++) {
+			set_with_zb_safe(u, v, color, P[2]);
+		}
+	}
+}
+
+
+void Image::draw_3d_point(V3 P, PPC *ppc, int psize,
+	unsigned int color) {
+	V3 PP;
+	if (!ppc->project(P, PP))
+		return;
+
+	draw_2d_point(PP, psize, color);
+}
+
+void Image::visualize_point_light(V3 l, PPC* ppc) {
+	draw_3d_point(l, ppc, 7, 0xFFFF0000);
+}
+
+void Image::draw_3d_segment(V3 V0, V3 V1, V3 C0, V3 C1, PPC* ppc) {
+	V3 PV0, PV1;
+	if (!ppc->project(V0, PV0)) return;
+	if (!ppc->project(V1, PV1)) return;
+	draw_2d_segment(PV0, PV1, C0, C1);
+}
+
+void Image::draw_2d_segment(V3 V0, V3 V1, V3 C0, V3 C1) {
+	int pixn = (int)((V1 - V0).length() + 2);
+	V3 curr_p = V0;
+	V3 p_diff = (V1 - V0) / (float)(pixn - 1);
+
+	V3 curr_c = C0;
+	V3 color_diff = (C1 - C0) / (float)(pixn - 1);
+
+	for (int si = 0; si < pixn; si++) {
+		unsigned int color = curr_c.convert_to_color_int();
+		set_with_zb_safe((int)curr_p[0], (int)curr_p[1], color, curr_p[2]);
+
+		curr_p += p_diff;
+		curr_c += color_diff;
+	}
+}
+
+void Image::draw_3d_triangle(V3 V0, V3 V1, V3 V2, V3 C0, V3 C1, V3 C2, PPC* ppc) {
+	V3 PV0, PV1, PV2;
+	if (!ppc->project(V0, PV0)) return;
+	if (!ppc->project(V1, PV1)) return;
+	if (!ppc->project(V2, PV2)) return;
+
+	draw_2d_triangle(PV0, PV1, PV2, C0, C1, C2);
+}
+
+void Image::draw_2d_triangle(V3 V0, V3 V1, V3 V2, V3 C0, V3 C1, V3 C2) {
+	ProfileScope setup(profile_stage::TRIANGLE_SETUP);
+
+	V3 a = V3();
+	V3 b = V3();
+	V3 c = V3();
+
+	//0 to 1
+	a[0] = V1[1] - V0[1]; 
+	b[0] = -V1[0] + V0[0];
+	c[0] = -V1[1] * V0[0] + V0[1] * V1[0];
+
+	//1 to 2
+	a[1] = V2[1] - V1[1];
+	b[1] = -V2[0] + V1[0];
+	c[1] = -V2[1] * V1[0] + V1[1] * V2[0];
+
+	//2 to 0
+	a[2] = V0[1] - V2[1];
+	b[2] = -V0[0] + V2[0];
+	c[2] = -V0[1] * V2[0] + V2[1] * V0[0];
+
+	float sidedness = a[0] * V2[0] + b[0] * V2[1] + c[0];
+	if (sidedness < 0) {
+		a[0] *= -1;
+		b[0] *= -1;
+		c[0] *= -1;
+	}
+
+	sidedness = a[1] * V0[0] + b[1] * V0[1] + c[1];
+	if (sidedness < 0) {
+		a[1] *= -1;
+		b[1] *= -1;
+		c[1] *= -1;
+	}
+
+	sidedness = a[2] * V1[0] + b[2] * V1[1] + c[2];
+	if (sidedness < 0) {
+		a[2] *= -1;
+		b[2] *= -1;
+		c[2] *= -1;
+	}
+
+	float umin = fmax(0.0f, fmin(fmin(V0[0], V1[0]), V2[0]));
+	float umax = fmin((float)(w - 1), fmax(fmax(V0[0], V1[0]), V2[0]));
+	float vmin = fmax(0.0f, fmin(fmin(V0[1], V1[1]), V2[1]));
+	float vmax = fmin((float)(h - 1), fmax(fmax(V0[1], V1[1]), V2[1]));
+
+	int left = (int)(umin + .5f);
+	int right = (int)(umax - .5f);
+	int top = (int)(vmin + .5f);
+	int bottom = (int)(vmax - .5f);
+
+	V3 currEELS = V3();
+	V3 currEE = V3();
+	
+	currEELS = a * (left + .5f) + b * (top + .5f) + c;
+	
+	//Computes twice signed area of the triangle using edge function V0-V1 and V2
+	float area = a[0] * V2[0] + b[0] * V2[1] + c[0]; 
+	setup.stop();
+	if (area == 0.0f || left > right || top > bottom) {
+		profile_count(profile_counter::TRIANGLES_CULLED, 1);
+		return;
+	}
+
+	profile_count(profile_counter::TRIANGLES_RASTERIZED, 1);
+	ProfileScope rasterization(profile_stage::RASTERIZATION);
+	PixelCounter pixels;
+	Heatmap* heat = heatmap;
+
+	for (int v = top; v <= bottom; v++) {
+		currEE = currEELS;
+		
+		for (int u = left; u <= right; u++) {
+			if (currEE[0] >= 0 && currEE[1] >= 0 && currEE[2] >= 0) {
+
+				//Computes barycentric weights
+				float weight_0 = (a[1] * u + b[1] * v + c[1]) / area;
+				float weight_1 = (a[2] * u + b[2] * v + c[2]) / area;
+				float weight_2 = 1.0f - weight_0 - weight_1;
+
+				//Interpolates depth and color
+				float curr_z = weight_0 * V0[2] + weight_1 * V1[2] + weight_2 * V2[2];
+				V3 color_vector = weight_0 * C0 + weight_1 * C1 + weight_2 * C2;
+				
+				pixels.tested();
+				pixels.shaded();
+				bool passed = set_with_zb(u, v, color_vector.convert_to_color_int(), curr_z);
+				if (passed)
+					pixels.passed();
+				if (heat) {
+					heat->tested(u, v);
+					heat->shaded(u, v);
+					if (passed)
+						heat->written(u, v);
+				}
+			}
+			currEE += a;
+		}
+		currEELS += b;
+	}
+
+}
+
+void Image::draw_2d_lighted_triangle(V3 V0, V3 V1, V3 V2, V3 P0, V3 P1, V3 P2, V3 N0, V3 N1, V3 N2,
+	V3 C0, V3 C1, V3 C2, PixelLighting* lighting) {
+	ProfileScope setup(profile_stage::TRIANGLE_SETUP);
+
+	V3 a = V3();
+	V3 b = V3();
+	V3 c = V3();
+
+	// 0 to 1
+	a[0] = V1[1] - V0[1];
+	b[0] = -V1[0] + V0[0];
+	c[0] = -V1[1] * V0[0] + V0[1] * V1[0];
+
+	// 1 to 2
+	a[1] = V2[1] - V1[1];
+	b[1] = -V2[0] + V1[0];
+	c[1] = -V2[1] * V1[0] + V1[1] * V2[0];
+
+	// 2 to 0
+	a[2] = V0[1] - V2[1];
+	b[2] = -V0[0] + V2[0];
+	c[2] = -V0[1] * V2[0] + V2[1] * V0[0];
+
+	float sidedness = a[0] * V2[0] + b[0] * V2[1] + c[0];
+	if (sidedness < 0) { a[0] *= -1; b[0] *= -1; c[0] *= -1; }
+
+	sidedness = a[1] * V0[0] + b[1] * V0[1] + c[1];
+	if (sidedness < 0) { a[1] *= -1; b[1] *= -1; c[1] *= -1; }
+
+	sidedness = a[2] * V1[0] + b[2] * V1[1] + c[2];
+	if (sidedness < 0) { a[2] *= -1; b[2] *= -1; c[2] *= -1; }
+
+	float umin = fmaxf(0.0f, fminf(fminf(V0[0], V1[0]), V2[0]));
+	float umax = fminf((float)(w - 1), fmaxf(fmaxf(V0[0], V1[0]), V2[0]));
+	float vmin = fmaxf(0.0f, fminf(fminf(V0[1], V1[1]), V2[1]));
+	float vmax = fminf((float)(h - 1), fmaxf(fmaxf(V0[1], V1[1]), V2[1]));
+
+	int left = (int)(umin + .5f);
+	int right = (int)(umax - .5f);
+	int top = (int)(vmin + .5f);
+	int bottom = (int)(vmax - .5f);
+
+	V3 currEELS = V3();
+	V3 currEE = V3();
+
+	currEELS = a * (left + .5f) + b * (top + .5f) + c;
+
+	// Twice the signed area for barycentric normalization
+	float area = a[0] * V2[0] + b[0] * V2[1] + c[0];
+	if (area == 0.0f || left > right || top > bottom) {
+		profile_count(profile_counter::TRIANGLES_CULLED, 1);
+		return;
+	}
+	profile_count(profile_counter::TRIANGLES_RASTERIZED, 1);
+	PixelCounter pixels;
+	Heatmap* heat = heatmap;
+
+	V3 invz = { V0[2], V1[2], V2[2] };
+
+	// Columns are the vertex attributes over z, for perspective-correct interpolation
+	M33 p_matrix, n_matrix, c_matrix;
+	p_matrix.set_column(0, P0 * invz[0]);
+	p_matrix.set_column(1, P1 * invz[1]);
+	p_matrix.set_column(2, P2 * invz[2]);
+	n_matrix.set_column(0, N0 * invz[0]);
+	n_matrix.set_column(1, N1 * invz[1]);
+	n_matrix.set_column(2, N2 * invz[2]);
+	c_matrix.set_column(0, C0 * invz[0]);
+	c_matrix.set_column(1, C1 * invz[1]);
+	c_matrix.set_column(2, C2 * invz[2]);
+
+	// Pixels that pass the depth test are queued in SoA form and lit a batch at a time
+	const int batch = 64;
+	int bu[batch];
+	float px[batch], py[batch], pz[batch];
+	float nx[batch], ny[batch], nz[batch];
+	V3 bc[batch];
+	float kd[batch], ks[batch];
+	int n = 0;
+
+	// With a light grid a batch never spans two tiles, so all its pixels share one light list
+	LightGrid* grid = lighting->grid;
+	int batch_tile = -1;
+
+	auto shade_batch = [&](int v) {
+		float ka = lighting->ka;
+		pixels.shaded(n);
+		if (heat) {
+			for (int i = 0; i < n; i++) {
+				heat->shaded(bu[i], v);
+			}
+		}
+
+		if (grid) {
+			int num_ids;
+			int* light_ids = grid->lights_in_tile(batch_tile, num_ids);
+			for (int i = 0; i < n; i++) {
+				kd[i] = 0.0f;
+				ks[i] = 0.0f;
+			}
+			accumulate_lights_soa(px, py, pz, nx, ny, nz, n, lighting->lights, light_ids, num_ids,
+				lighting->eye_pos, lighting->table, kd, ks);
+
+			for (int i = 0; i < n; i++) {
+				V3 color = bc[i] * (ka + (1.0f - ka) * kd[i] + ks[i]);
+				set(bu[i], v, color.convert_to_color_int());
+			}
+			n = 0;
+			return;
+		}
+
+		light_terms_soa(px, py, pz, nx, ny, nz, n, lighting->light_pos, lighting->eye_pos,
+			lighting->table, kd, ks);
+
+		for (int i = 0; i < n; i++) {
+			V3 color = bc[i] * ka; // ambient only when in shadow
+			if (!lighting->shadow_map || !lighting->shadow_map->in_shadow(V3(px[i], py[i], pz[i])))
+				color = bc[i] * (ka + (1.0f - ka) * kd[i] + ks[i]);
+			set(bu[i], v, color.convert_to_color_int());
+		}
+		n = 0;
+	};
+
+	setup.stop();
+	ProfileScope rasterization(profile_stage::RASTERIZATION);
+
+	for (int v = top; v <= bottom; v++) {
+		currEE = currEELS;
+
+		for (int u = left; u <= right; u++) {
+			if (currEE[0] >= 0 && currEE[1] >= 0 && currEE[2] >= 0) {
+				// Barycentric weights (screen-space)
+				float w0 = (a[1] * u + b[1] * v + c[1]) / area;
+				float w1 = (a[2] * u + b[2] * v + c[2]) / area;
+				float w2 = 1.0f - w0 - w1;
+				V3 w = { w0, w1, w2 };
+
+				float curr_z = w * invz;
+
+				// Depth test first so only visible pixels get shaded
+				pixels.tested();
+				if (heat)
+					heat->tested(u, v);
+				if (!is_farther(u, v, curr_z)) {
+					set_zb(u, v, curr_z);
+					pixels.passed();
+					if (heat)
+						heat->written(u, v);
+
+					if (grid) {
+						int tile = grid->get_tile(u, v);
+						if (n > 0 && tile != batch_tile)
+							shade_batch(v);
+						batch_tile = tile;
+					}
+
+					V3 P = p_matrix * w / curr_z;
+					V3 N = n_matrix * w / curr_z;
+					N *= 1.0f / sqrtf(fmaxf(N * N, 1e-20f));
+
+					bu[n] = u;
+					px[n] = P[0];
+					py[n] = P[1];
+					pz[n] = P[2];
+					nx[n] = N[0];
+					ny[n] = N[1];
+					nz[n] = N[2];
+					bc[n] = c_matrix * w / curr_z;
+					n++;
+
+					if (n == batch)
+						shade_batch(v);
+				}
+			}
+			currEE += a;
+		}
+
+		if (n > 0)
+			shade_batch(v);
+
+		currEELS += b;
+	}
+}
+
+void Image::draw_2d_texture_triangle(V3 V0, V3 V1, V3 V2, V3 tex0, V3 tex1, V3 tex2, bool mirror_tiling, Image* tex) {
+	ProfileScope setup(profile_stage::TRIANGLE_SETUP);
+
+    V3 a = V3();
+    V3 b = V3();
+    V3 c = V3();
+
+    // 0 to 1
+    a[0] = V1[1] - V0[1];
+    b[0] = -V1[0] + V0[0];
+    c[0] = -V1[1] * V0[0] + V0[1] * V1[0];
+
+    // 1 to 2
+    a[1] = V2[1] - V1[1];
+    b[1] = -V2[0] + V1[0];
+    c[1] = -V2[1] * V1[0] + V1[1] * V2[0];
+
+    // 2 to 0
+    a[2] = V0[1] - V2[1];
+    b[2] = -V0[0] + V2[0];
+    c[2] = -V0[1] * V2[0] + V2[1] * V0[0];
+
+    float sidedness = a[0] * V2[0] + b[0] * V2[1] + c[0];
+    if (sidedness < 0) { a[0] *= -1; b[0] *= -1; c[0] *= -1; }
+
+    sidedness = a[1] * V0[0] + b[1] * V0[1] + c[1];
+    if (sidedness < 0) { a[1] *= -1; b[1] *= -1; c[1] *= -1; }
+
+    sidedness = a[2] * V1[0] + b[2] * V1[1] + c[2];
+    if (sidedness < 0) { a[2] *= -1; b[2] *= -1; c[2] *= -1; }
+
+    float umin = fmaxf(0.0f, fminf(fminf(V0[0], V1[0]), V2[0]));
+    float umax = fminf((float)(w - 1), fmaxf(fmaxf(V0[0], V1[0]), V2[0]));
+    float vmin = fmaxf(0.0f, fminf(fminf(V0[1], V1[1]), V2[1]));
+    float vmax = fminf((float)(h - 1), fmaxf(fmaxf(V0[1], V1[1]), V2[1]));
+
+    int left = (int)(umin + .5f);
+    int right = (int)(umax - .5f);
+    int top = (int)(vmin + .5f);
+    int bottom = (int)(vmax - .5f);
+
+    V3 currEELS = V3();
+    V3 currEE = V3();
+	
+	currEELS = a * (left + .5f) + b * (top + .5f) + c;
+	
+	// Twice the signed area for barycentric normalization
+	float area = a[0] * V2[0] + b[0] * V2[1] + c[0];
+	if (area == 0.0f || left > right || top > bottom) {
+		profile_count(profile_counter::TRIANGLES_CULLED, 1);
+		return;
+	}
+	profile_count(profile_counter::TRIANGLES_RASTERIZED, 1);
+	PixelCounter pixels;
+	Heatmap* heat = heatmap;
+
+	V3 invz = { V0[2], V1[2], V2[2] };
+
+	V3 tex0_over_z = tex0 * invz[0];
+	V3 tex1_over_z = tex1 * invz[1];
+	V3 tex2_over_z = tex2 * invz[2];
+
+	V3 u_over_z = { tex0_over_z[0], tex1_over_z[0], tex2_over_z[0] };
+	V3 v_over_z = { tex0_over_z[1], tex1_over_z[1], tex2_over_z[1] };
+
+	setup.stop();
+	ProfileScope rasterization(profile_stage::RASTERIZATION);
+
+    for (int v = top; v <= bottom; v++) {
+        currEE = currEELS;
+
+        for (int u = left; u <= right; u++) {
+            if (currEE[0] >= 0 && currEE[1] >= 0 && currEE[2] >= 0) {
+                // Barycentric weights (screen-space)
+                float w0 = (a[1] * u + b[1] * v + c[1]) / area;
+                float w1 = (a[2] * u + b[2] * v + c[2]) / area;
+                float w2 = 1.0f - w0 - w1;
+
+				V3 w = { w0, w1, w2 };
+
+                // Interpolate depth for z-buffer (affine is fine for z)
+				float curr_z = w * invz + .00001f;
+
+                // Perspective-correct interpolate texture coordinates
+				float tu = w * u_over_z / curr_z;
+				float tv = w * v_over_z / curr_z;
+
+				if (!mirror_tiling) {
+					// Clamp to [0, 1] range while accounting for tiling, no mirroring
+					tu -= floor(tu);
+					tv -= floor(tv);
+				}
+				else {
+					//Mirroring mode for tiling
+					if (int(floor(tu)) % 2 == 1)
+						tu = 1.0f - (tu - floor(tu));
+					else
+						tu -= floor(tu);
+
+					if (int(floor(tv)) % 2 == 1)
+						tv = 1.0f - (tv - floor(tv));
+					else
+						tv -= floor(tv);
+				}
+
+				unsigned int color = tex->get(tu, tv);
+				pixels.tested();
+				pixels.shaded();
+				bool passed = set_with_zb(u, v, color, curr_z);
+				if (passed)
+					pixels.passed();
+				if (heat) {
+					heat->tested(u, v);
+					heat->shaded(u, v);
+					if (passed)
+						heat->written(u, v);
+				}
+            }
+            currEE += a;
+        }
+        currEELS += b;
+    }
+}
+
+void Image::set_checker(int cw, unsigned int col0, unsigned int col1) {
+	for (int v = 0; v < h; v++) {
+		for (int u = 0; u < w; u++) {
+			int cu, cv;
+			cu = u / cw;
+			cv = v / cw;
+			if ((cu+cv)%2)
+				set(u, v, col0);
+			else
+				set(u, v, col1);
+		}
+	}
+}
+
+void Image::draw_2d_mirrored_triangle(V3 V0, V3 V1, V3 V2, V3 N0, V3 N1, V3 N2, PPC* ppc, CubeMap* cube_map) {
+	ProfileScope setup(profile_stage::TRIANGLE_SETUP);
+
+    V3 a = V3();
+    V3 b = V3();
+    V3 c = V3();
+
+    // 0 to 1
+    a[0] = V1[1] - V0[1];
+    b[0] = -V1[0] + V0[0];
+    c[0] = -V1[1] * V0[0] + V0[1] * V1[0];
+
+    // 1 to 2
+    a[1] = V2[1] - V1[1];
+    b[1] = -V2[0] + V1[0];
+    c[1] = -V2[1] * V1[0] + V1[1] * V2[0];
+
+    // 2 to 0
+    a[2] = V0[1] - V2[1];
+    b[2] = -V0[0] + V2[0];
+    c[2] = -V0[1] * V2[0] + V2[1] * V0[0];
+
+    float sidedness = a[0] * V2[0] + b[0] * V2[1] + c[0];
+    if (sidedness < 0) { a[0] *= -1; b[0] *= -1; c[0] *= -1; }
+
+    sidedness = a[1] * V0[0] + b[1] * V0[1] + c[1];
+    if (sidedness < 0) { a[1] *= -1; b[1] *= -1; c[1] *= -1; }
+
+    sidedness = a[2] * V1[0] + b[2] * V1[1] + c[2];
+    if (sidedness < 0) { a[2] *= -1; b[2] *= -1; c[2] *= -1; }
+
+    float umin = fmaxf(0.0f, fminf(fminf(V0[0], V1[0]), V2[0]));
+    float umax = fminf((float)(w - 1), fmaxf(fmaxf(V0[0], V1[0]), V2[0]));
+    float vmin = fmaxf(0.0f, fminf(fminf(V0[1], V1[1]), V2[1]));
+    float vmax = fminf((float)(h - 1), fmaxf(fmaxf(V0[1], V1[1]), V2[1]));
+
+    int left = (int)(umin + .5f);
+    int right = (int)(umax - .5f);
+    int top = (int)(vmin + .5f);
+    int bottom = (int)(vmax - .5f);
+
+    V3 currEELS = V3();
+    V3 currEE = V3();
+	
+	currEELS = a * (left + .5f) + b * (top + .5f) + c;
+	
+	// Twice the signed area for barycentric normalization
+	float area = a[0] * V2[0] + b[0] * V2[1] + c[0];
+	if (area == 0.0f || left > right || top > bottom) {
+		profile_count(profile_counter::TRIANGLES_CULLED, 1);
+		return;
+	}
+	profile_count(profile_counter::TRIANGLES_RASTERIZED, 1);
+	PixelCounter pixels;
+	Heatmap* heat = heatmap;
+
+	V3 invz = { V0[2], V1[2], V2[2] };
+
+	V3 n0_over_z = N0 * invz[0];
+	V3 n1_over_z = N1 * invz[1];
+	V3 n2_over_z = N2 * invz[2];
+
+	M33 n_matrix;
+	n_matrix.set_column(0, n0_over_z);
+	n_matrix.set_column(1, n1_over_z);
+	n_matrix.set_column(2, n2_over_z);
+	
+
+	setup.stop();
+	ProfileScope rasterization(profile_stage::RASTERIZATION);
+
+    for (int v = top; v <= bottom; v++) {
+        currEE = currEELS;
+
+        for (int u = left; u <= right; u++) {
+            if (currEE[0] >= 0 && currEE[1] >= 0 && currEE[2] >= 0) {
+                // Barycentric weights (screen-space)
+                float w0 = (a[1] * u + b[1] * v + c[1]) / area;
+                float w1 = (a[2] * u + b[2] * v + c[2]) / area;
+                float w2 = 1.0f - w0 - w1;
+				V3 w = { w0, w1, w2 };
+
+                // Interpolate depth for z-buffer 
+				float curr_z = w * invz + .00001f;
+
+                // Perspective-correct interpolate normal vector (model space)
+				V3 n = n_matrix * w / curr_z;
+
+                unsigned int color = cube_map->get_color(n.reflected(ppc->C - V3((float)u, (float)v, curr_z)));
+				pixels.tested();
+				pixels.shaded();
+				bool passed = set_with_zb(u, v, color, curr_z);
+				if (passed)
+					pixels.passed();
+				if (heat) {
+					heat->tested(u, v);
+					heat->shaded(u, v);
+					if (passed)
+						heat->written(u, v);
+				}
+
+            }
+            currEE += a;
+        }
+        currEELS += b;
+    }
+}
+
+
+unsigned int* Image::get_vert_flipped_pixels() {
+	unsigned int* flippedPixels = new unsigned int[w * h];
+	for (int row = 0; row < h; row++) {
+		int src = row * w;
+		int dst = (h - 1 - row) * w;
+		for (int col = 0; col < w; col++) {
+			flippedPixels[dst + col] = pix[src + col];
+		}
+	}
+	return flippedPixels;
+}
+
+unsigned int* Image::get_vert_and_horiz_flipped_pixels() {
+	unsigned int* flippedPixels = new unsigned int[w * h];
+	for (int row = 0; row < h; row++) {
+		int src = row * w;
+		int dst = (h - 1 - row) * w;
+		for (int col = 0; col < w; col++) {
+			flippedPixels[dst + (w - 1 - col)] = pix[src + col];
+		}
+	}
+	return flippedPixels;
+}
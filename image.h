@@ -0,0 +1,85 @@
+#pragma once
+
+#include "ppc.h"
+
+class CubeMap;
+class Heatmap;
+struct PixelLighting;
+
+// Color and depth surface the software pipeline draws into and samples textures from.
+// Owns aligned storage and has no window, so it works off the GUI thread and without a
+// display. FrameBuffer is an Image shown in a window.
+class Image {
+public:
+	unsigned int* pix;
+	float* zb; // null for images without depth, e.g. textures
+	Heatmap* heatmap; // per-pixel work counts of the frame, null unless enabled with set_heatmap
+	int w, h;
+
+	Image(int _w, int _h, bool with_depth = true);
+	virtual ~Image();
+
+	void load_tiff(char* fname);
+	void save_as_tiff(char* fname);
+	void set_pixels(int width, int height, const unsigned int* src); // resizes to width x height and copies src
+
+	void set_heatmap(bool enabled);
+
+	void clear(); // clears the heatmap counts too
+	void set(unsigned int color);
+	void set(int u, int v, unsigned int color);
+	void set_safe(int u, int v, unsigned int color);
+
+	void set_zb(float z);
+	void set_zb(int u, int v, float z);
+	void set_zb_safe(int u, int v, float z);
+
+	bool set_with_zb(int u, int v, unsigned int color, float z); // false when z failed the depth test
+	void set_with_zb_safe(int u, int v, unsigned int color, float z);
+
+	void set_checker(int cw, unsigned int col0, unsigned int col1);
+
+	unsigned int get(int u, int v);
+	unsigned int get(float tu, float tv); //tu is [0, 1], tv is [0, 1]
+
+	float get_zb(int u, int v);
+
+	bool is_farther(int u, int v, float z);
+	bool is_farther_safe(int u, int v, float z);
+
+	void draw_rectangle(int u, int v, int width, int height, unsigned int color);
+	void draw_circle(int u, int v, int radius, unsigned int color);
+	void draw_line(int u1, int v1, int u2, int v2, unsigned int color);
+	void draw_line_safe(int u1, int v1, int u2, int v2, unsigned int color);
+
+	// Top left corner of the first character at (u, v), every font pixel as a scale x scale
+	// square, \n starts a new line. Clipped to the image.
+	void draw_text(int u, int v, const char* text, unsigned int color, int scale = 1);
+
+	void draw_2d_point(V3 p, int psize, unsigned int color);
+	void draw_3d_point(V3 p, PPC* ppc, int psize, unsigned int color);
+	void visualize_point_light(V3 l, PPC* ppc);
+
+	void draw_2d_segment(V3 V0, V3 V1, V3 C0, V3 C1);
+	void draw_3d_segment(V3 V0, V3 V1, V3 C0, V3 C1, PPC* ppc);
+
+	void draw_2d_triangle(V3 V0, V3 V1, V3 V2, V3 C0, V3 C1, V3 C2);
+	void draw_3d_triangle(V3 V0, V3 V1, V3 V2, V3 C0, V3 C1, V3 C2, PPC* ppc);
+
+	//Per-pixel lighting: P are world positions, N normals and C colors of the vertices
+	void draw_2d_lighted_triangle(V3 V0, V3 V1, V3 V2, V3 P0, V3 P1, V3 P2, V3 N0, V3 N1, V3 N2,
+		V3 C0, V3 C1, V3 C2, PixelLighting* lighting);
+
+	void draw_2d_texture_triangle(V3 V0, V3 V1, V3 V2, V3 C0, V3 C1, V3 C2, bool mirror_tiling, Image* tex);
+
+	void draw_2d_mirrored_triangle(V3 V0, V3 V1, V3 V2, V3 N0, V3 N1, V3 N2, PPC* ppc, CubeMap* cube_map);
+
+	unsigned int* get_vert_flipped_pixels(); //For HW texture use
+	unsigned int* get_vert_and_horiz_flipped_pixels(); //For HW Cube Map use
+
+private:
+	void allocate(int _w, int _h, bool with_depth);
+
+	Image(const Image&) = delete;
+	Image& operator=(const Image&) = delete;
+};
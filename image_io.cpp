@@ -0,0 +1,106 @@
+#include "image_io.h"
+#include "tiffio.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+bool read_tiff_rgba(char* fname, int& w, int& h, vector<unsigned int>& pix) {
+	TIFF* in = TIFFOpen(fname, "r");
+	if (in == NULL) {
+		cerr << fname << " could not be opened" << endl;
+		return false;
+	}
+
+	int width = 0, height = 0;
+	TIFFGetField(in, TIFFTAG_IMAGEWIDTH, &width);
+	TIFFGetField(in, TIFFTAG_IMAGELENGTH, &height);
+	if (width <= 0 || height <= 0) {
+		cerr << "ERROR: " << fname << " has no image" << endl;
+		TIFFClose(in);
+		return false;
+	}
+
+	pix.resize((size_t)width * height);
+	bool ok = TIFFReadRGBAImage(in, width, height, (uint32*)pix.data(), 0) != 0;
+	TIFFClose(in);
+	if (!ok) {
+		cerr << "failed to load " << fname << endl;
+		return false;
+	}
+
+	w = width;
+	h = height;
+	return true;
+}
+
+bool parse_tiff_compression(const char* name, tiff_compression& compression) {
+	const char* names[] = { "none", "lzw", "deflate", "packbits" };
+	const tiff_compression values[] = { tiff_compression::NONE, tiff_compression::LZW,
+		tiff_compression::DEFLATE, tiff_compression::PACKBITS };
+	for (int i = 0; i < 4; i++) {
+		if (strcmp(name, names[i]) == 0) {
+			compression = values[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+bool write_tiff_rgba(char* fname, const unsigned int* pix, int w, int h, tiff_compression compression) {
+	uint16 scheme = COMPRESSION_NONE;
+	if (compression == tiff_compression::LZW)
+		scheme = COMPRESSION_LZW;
+	else if (compression == tiff_compression::PACKBITS)
+		scheme = COMPRESSION_PACKBITS;
+	else if (compression == tiff_compression::DEFLATE) {
+		scheme = COMPRESSION_ADOBE_DEFLATE;
+		if (!TIFFIsCODECConfigured(scheme)) {
+			static bool warned = false;
+			if (!warned)
+				cerr << "INFO: libtiff has no deflate support, writing LZW instead" << endl;
+			warned = true;
+			scheme = COMPRESSION_LZW;
+		}
+	}
+
+	TIFF* out = TIFFOpen(fname, "w");
+	if (out == NULL) {
+		cerr << fname << " could not be opened" << endl;
+		return false;
+	}
+
+	TIFFSetField(out, TIFFTAG_IMAGEWIDTH, w);
+	TIFFSetField(out, TIFFTAG_IMAGELENGTH, h);
+	TIFFSetField(out, TIFFTAG_SAMPLESPERPIXEL, 4);
+	TIFFSetField(out, TIFFTAG_BITSPERSAMPLE, 8);
+	TIFFSetField(out, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
+	TIFFSetField(out, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(out, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+	TIFFSetField(out, TIFFTAG_COMPRESSION, scheme);
+	// Horizontal differencing makes smooth rendered images compress much better
+	if (scheme == COMPRESSION_LZW || scheme == COMPRESSION_ADOBE_DEFLATE)
+		TIFFSetField(out, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+
+	// Strips of about 64 KB, one scanline each makes the strip tables and codec overhead dominate
+	int rows_per_strip = max(1, min(h, (64 * 1024) / max(1, w * 4)));
+	TIFFSetField(out, TIFFTAG_ROWSPERSTRIP, rows_per_strip);
+
+	// The codecs encode in place (the predictor differences the buffer), so strips are copied
+	vector<unsigned int> strip((size_t)w * rows_per_strip);
+	bool ok = true;
+	for (int row = 0, si = 0; row < h && ok; row += rows_per_strip, si++) {
+		int rows = min(rows_per_strip, h - row);
+		for (int r = 0; r < rows; r++) {
+			memcpy(&strip[(size_t)r * w], &pix[(size_t)(h - 1 - row - r) * w], (size_t)w * sizeof(unsigned int));
+		}
+		ok = TIFFWriteEncodedStrip(out, si, strip.data(), (tmsize_t)rows * w * sizeof(unsigned int)) >= 0;
+	}
+
+	TIFFClose(out);
+	if (!ok)
+		cerr << "ERROR: failed writing " << fname << endl;
+	return ok;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <vector>
+
+// Image decoding that does not touch any window or GL state, so it is safe to call from
+// worker threads. Pixels are RGBA8, bottom row first, the layout Image::pix uses.
+bool read_tiff_rgba(char* fname, int& w, int& h, std::vector<unsigned int>& pix);
+
+enum class tiff_compression {
+	NONE,
+	LZW,
+	DEFLATE, // falls back to LZW when libtiff was built without zlib
+	PACKBITS
+};
+
+bool parse_tiff_compression(const char* name, tiff_compression& compression); // none, lzw, deflate or packbits
+
+// Writes pix (same layout as above) as a top row first TIFF in strips of several rows
+bool write_tiff_rgba(char* fname, const unsigned int* pix, int w, int h,
+	tiff_compression compression = tiff_compression::NONE);
@@ -0,0 +1,127 @@
+#include "image_writer.h"
+#include "image.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+ImageWriter::ImageWriter(tiff_compression _compression, int _max_jobs) {
+	compression = _compression;
+	max_jobs = max(1, _max_jobs);
+	busy = false;
+	stopping = false;
+	written = 0;
+	failed = 0;
+	max_queued = 0;
+	io_thread = thread(&ImageWriter::io_loop, this);
+}
+
+ImageWriter::~ImageWriter() {
+	{
+		lock_guard<mutex> lock(mtx);
+		stopping = true;
+	}
+	cv.notify_all();
+	io_thread.join();
+}
+
+void ImageWriter::write(const string& fname, Image* image) {
+	Job job;
+	job.fname = fname;
+	job.w = image->w;
+	job.h = image->h;
+	{
+		unique_lock<mutex> lock(mtx);
+		{
+			TraceScope trace("ImageWriter wait for queue");
+			cv.wait(lock, [this] { return (int)jobs.size() < max_jobs; });
+		}
+		if (!free_buffers.empty()) {
+			job.pix = move(free_buffers.back());
+			free_buffers.pop_back();
+		}
+	}
+
+	// Same sized frames reuse the allocation, the copy is all the caller pays for
+	job.pix.resize((size_t)job.w * job.h);
+	memcpy(job.pix.data(), image->pix, job.pix.size() * sizeof(unsigned int));
+
+	{
+		lock_guard<mutex> lock(mtx);
+		jobs.push_back(move(job));
+		max_queued = max(max_queued, (int)jobs.size());
+	}
+	cv.notify_all();
+}
+
+void ImageWriter::flush() {
+	unique_lock<mutex> lock(mtx);
+	cv.wait(lock, [this] { return jobs.empty() && !busy; });
+}
+
+int ImageWriter::get_written() {
+	lock_guard<mutex> lock(mtx);
+	return written;
+}
+
+int ImageWriter::get_failed() {
+	lock_guard<mutex> lock(mtx);
+	return failed;
+}
+
+int ImageWriter::get_max_queued() {
+	lock_guard<mutex> lock(mtx);
+	return max_queued;
+}
+
+void ImageWriter::io_loop() {
+	tracer()->set_thread_name("image writer");
+	while (true) {
+		Job job;
+		{
+			unique_lock<mutex> lock(mtx);
+			cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+			// Queued frames are still written when stopping
+			if (jobs.empty())
+				return;
+			job = move(jobs.front());
+			jobs.pop_front();
+			busy = true;
+		}
+		cv.notify_all(); // a write() may be waiting for room in the queue
+
+		bool ok;
+		{
+			TraceScope trace("write_tiff_rgba");
+			ok = write_tiff_rgba((char*)job.fname.c_str(), job.pix.data(), job.w, job.h, compression);
+		}
+
+		{
+			lock_guard<mutex> lock(mtx);
+			if (ok)
+				written++;
+			else
+				failed++;
+			free_buffers.push_back(move(job.pix));
+			busy = false;
+		}
+		cv.notify_all();
+	}
+}
+
+bool make_directory(const string& dir) {
+#ifdef _WIN32
+	return _mkdir(dir.c_str()) == 0 || errno == EEXIST;
+#else
+	return mkdir(dir.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "image_io.h"
+
+class Image;
+
+// Saves frames as TIFFs from its own I/O thread. write() only copies the pixels into a
+// recycled buffer and queues them, encoding and the disk happen in the background. When the
+// disk falls behind, up to max_jobs frames queue up before write() waits, which bounds the
+// memory to max_jobs + 1 frame buffers however long the camera path is.
+class ImageWriter {
+public:
+	ImageWriter(tiff_compression _compression = tiff_compression::NONE, int _max_jobs = 8);
+	~ImageWriter(); // writes everything still queued
+
+	void write(const std::string& fname, Image* image); // blocks while max_jobs frames are queued
+	void flush(); // blocks until every queued frame is written
+
+	int get_written();
+	int get_failed();
+	int get_max_queued(); // most frames ever waiting at once, how far the disk fell behind
+
+private:
+	struct Job {
+		std::string fname;
+		std::vector<unsigned int> pix;
+		int w, h;
+	};
+
+	tiff_compression compression;
+	int max_jobs;
+
+	std::thread io_thread;
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::deque<Job> jobs;
+	std::vector<std::vector<unsigned int>> free_buffers; // pixel buffers of written frames
+	bool busy; // io thread is encoding a frame
+	bool stopping;
+	int written, failed, max_queued;
+
+	void io_loop();
+
+	ImageWriter(const ImageWriter&) = delete;
+	ImageWriter& operator=(const ImageWriter&) = delete;
+};
+
+bool make_directory(const std::string& dir); // true when dir exists afterwards
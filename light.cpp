@@ -0,0 +1,139 @@
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+
+#include "light.h"
+#include "ppc.h"
+
+using namespace std;
+
+PointLight::PointLight(V3 _pos, float _radius, bool _casts_shadows) {
+	pos = _pos;
+	radius = _radius;
+	casts_shadows = _casts_shadows;
+	shadow_map = nullptr;
+	shadows_map_version = 0;
+	shadows_geometry_version = 0;
+}
+
+float PointLight::get_inv_radius2() {
+	if (radius >= FLT_MAX)
+		return 0.0f;
+	return 1.0f / (radius * radius);
+}
+
+float PointLight::attenuation(float dist2) {
+	float att = fmaxf(0.0f, 1.0f - dist2 * get_inv_radius2());
+	return att * att;
+}
+
+LightGrid::LightGrid() {
+	tiles_w = 0;
+	tiles_h = 0;
+}
+
+bool LightGrid::get_tile_rect(PointLight* light, PPC* ppc, int rect[4]) {
+	// Whole screen unless the sphere's projection can be bounded
+	rect[0] = 0;
+	rect[1] = 0;
+	rect[2] = tiles_w - 1;
+	rect[3] = tiles_h - 1;
+
+	if (light->radius >= FLT_MAX)
+		return true;
+
+	float r = light->radius;
+	float d = (light->pos - ppc->C) * ppc->get_vd();
+
+	if (d + r <= 0.0f) // entirely behind the camera
+		return false;
+
+	if (d - r <= 1e-3f) // sphere reaches the camera plane
+		return true;
+
+	// The sphere lies inside its bounding box, and a box fully in front of the camera projects
+	// inside the screen bounds of its eight corners. A corner behind the camera, which a sphere
+	// close to the camera plane can have, gives up on bounding it.
+	float pu[2] = { FLT_MAX, -FLT_MAX };
+	float pv[2] = { FLT_MAX, -FLT_MAX };
+	for (int i = 0; i < 8; i++) {
+		V3 corner = light->pos + V3((i & 1) ? r : -r, (i & 2) ? r : -r, (i & 4) ? r : -r);
+		V3 PP;
+		if (!ppc->project(corner, PP))
+			return true;
+		pu[0] = fminf(pu[0], PP[0]);
+		pu[1] = fmaxf(pu[1], PP[0]);
+		pv[0] = fminf(pv[0], PP[1]);
+		pv[1] = fmaxf(pv[1], PP[1]);
+	}
+
+	float umin = floorf(pu[0] / (float)tile_size);
+	float umax = floorf(pu[1] / (float)tile_size);
+	float vmin = floorf(pv[0] / (float)tile_size);
+	float vmax = floorf(pv[1] / (float)tile_size);
+
+	if (umax < 0.0f || vmax < 0.0f || umin > (float)(tiles_w - 1) || vmin > (float)(tiles_h - 1))
+		return false;
+
+	rect[0] = (int)fmaxf(0.0f, umin);
+	rect[1] = (int)fmaxf(0.0f, vmin);
+	rect[2] = (int)fminf((float)(tiles_w - 1), umax);
+	rect[3] = (int)fminf((float)(tiles_h - 1), vmax);
+	return true;
+}
+
+void LightGrid::build(vector<PointLight*>& lights, PPC* ppc) {
+	tiles_w = (ppc->w + tile_size - 1) / tile_size;
+	tiles_h = (ppc->h + tile_size - 1) / tile_size;
+	int num_tiles = tiles_w * tiles_h;
+
+	int num_lights = (int)lights.size();
+	vector<int> rects(num_lights * 4);
+	vector<bool> visible(num_lights);
+
+	// Count per tile, prefix sum into offsets, then fill
+	tile_offsets.assign(num_tiles + 1, 0);
+	for (int li = 0; li < num_lights; li++) {
+		int* rect = &rects[li * 4];
+		visible[li] = get_tile_rect(lights[li], ppc, rect);
+		if (!visible[li])
+			continue;
+		for (int tv = rect[1]; tv <= rect[3]; tv++) {
+			for (int tu = rect[0]; tu <= rect[2]; tu++) {
+				tile_offsets[tv * tiles_w + tu + 1]++;
+			}
+		}
+	}
+
+	for (int t = 0; t < num_tiles; t++) {
+		tile_offsets[t + 1] += tile_offsets[t];
+	}
+
+	tile_lights.resize(tile_offsets[num_tiles]);
+	vector<int> fill(tile_offsets.begin(), tile_offsets.end() - 1);
+	for (int li = 0; li < num_lights; li++) {
+		if (!visible[li])
+			continue;
+		int* rect = &rects[li * 4];
+		for (int tv = rect[1]; tv <= rect[3]; tv++) {
+			for (int tu = rect[0]; tu <= rect[2]; tu++) {
+				tile_lights[fill[tv * tiles_w + tu]++] = li;
+			}
+		}
+	}
+}
+
+int LightGrid::get_tile(int u, int v) {
+	if (u < 0 || v < 0)
+		return -1;
+	int tu = u / tile_size;
+	int tv = v / tile_size;
+	if (tu >= tiles_w || tv >= tiles_h)
+		return -1;
+	return tv * tiles_w + tu;
+}
+
+int* LightGrid::lights_in_tile(int tile, int& count) {
+	count = tile_offsets[tile + 1] - tile_offsets[tile];
+	return tile_lights.data() + tile_offsets[tile];
+}
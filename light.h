@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+
+#include "v3.h"
+
+class PPC;
+class ShadowMap;
+
+class PointLight {
+public:
+	V3 pos;
+	float radius; // no contribution beyond radius, FLT_MAX for an unbounded light
+	bool casts_shadows;
+	ShadowMap* shadow_map; // only used when casts_shadows, created by Scene::render_shadows if null
+
+	// versions the shadow map was last rendered for, see Scene::render_shadows
+	unsigned int shadows_map_version;
+	unsigned int shadows_geometry_version;
+
+	PointLight(V3 _pos, float _radius, bool _casts_shadows);
+
+	float get_inv_radius2(); // 1 / radius^2, 0 for an unbounded light
+	float attenuation(float dist2); // smooth falloff from 1 at the light to 0 at radius
+};
+
+// Screen split into tiles, each with the list of lights whose sphere of influence overlaps it
+class LightGrid {
+public:
+	static const int tile_size = 16;
+
+	int tiles_w, tiles_h;
+
+	LightGrid();
+
+	void build(std::vector<PointLight*>& lights, PPC* ppc);
+
+	int get_tile(int u, int v); // -1 when (u, v) is off screen
+	int* lights_in_tile(int tile, int& count);
+
+private:
+	std::vector<int> tile_offsets; // lights of tile t are tile_lights[tile_offsets[t]] to tile_lights[tile_offsets[t + 1] - 1]
+	std::vector<int> tile_lights;
+
+	bool get_tile_rect(PointLight* light, PPC* ppc, int rect[4]); // false if the light covers no tile
+};
@@ -0,0 +1,377 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <xmmintrin.h>
+
+#include "lighting.h"
+#include "light.h"
+#include "ppc.h"
+#include "shadow_map.h"
+#include "directional_shadow_map.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+using namespace std;
+
+SpecularTable::SpecularTable() {
+	exp = -1;
+	set_exp(0);
+}
+
+void SpecularTable::set_exp(int specular_exp) {
+	if (specular_exp == exp)
+		return;
+
+	exp = specular_exp;
+	for (int i = 0; i <= size; i++) {
+		values[i] = powf((float)i / (float)size, (float)exp);
+	}
+	values[size + 1] = values[size]; //Padding so x == 1 can interpolate without a branch
+}
+
+float SpecularTable::lookup(float x) {
+	x = fmaxf(0.0f, fminf(1.0f, x)) * (float)size;
+	int i = (int)x;
+	float t = x - (float)i;
+	return values[i] + t * (values[i + 1] - values[i]);
+}
+
+SpecularTable* specular_table(int specular_exp) {
+	static thread_local SpecularTable table;
+	table.set_exp(specular_exp);
+	return &table;
+}
+
+//Fast 1/sqrt(x): ~12 bit estimate refined with one Newton-Raphson step, zero length safe
+static inline __m128 rsqrt_nr(__m128 x) {
+	x = _mm_max_ps(x, _mm_set1_ps(1e-20f));
+	__m128 y = _mm_rsqrt_ps(x);
+	__m128 yy_x = _mm_mul_ps(_mm_mul_ps(y, y), x);
+	return _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), y), _mm_sub_ps(_mm_set1_ps(3.0f), yy_x));
+}
+
+static inline __m128 dot3(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz) {
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+}
+
+//light is a position, or for a directional light the normalized direction toward the light
+static void light_terms_soa_impl(const float* px, const float* py, const float* pz,
+	const float* nx, const float* ny, const float* nz, int n,
+	V3 light, bool directional, V3 eye_pos, SpecularTable* table, float* kd, float* ks) {
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 two = _mm_set1_ps(2.0f);
+	__m128 Lx = _mm_set1_ps(light[0]);
+	__m128 Ly = _mm_set1_ps(light[1]);
+	__m128 Lz = _mm_set1_ps(light[2]);
+	__m128 Ex = _mm_set1_ps(eye_pos[0]);
+	__m128 Ey = _mm_set1_ps(eye_pos[1]);
+	__m128 Ez = _mm_set1_ps(eye_pos[2]);
+
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128 x = _mm_loadu_ps(px + i);
+		__m128 y = _mm_loadu_ps(py + i);
+		__m128 z = _mm_loadu_ps(pz + i);
+		__m128 nxv = _mm_loadu_ps(nx + i);
+		__m128 nyv = _mm_loadu_ps(ny + i);
+		__m128 nzv = _mm_loadu_ps(nz + i);
+
+		//Normalized light direction
+		__m128 lx = Lx;
+		__m128 ly = Ly;
+		__m128 lz = Lz;
+		if (!directional) {
+			lx = _mm_sub_ps(Lx, x);
+			ly = _mm_sub_ps(Ly, y);
+			lz = _mm_sub_ps(Lz, z);
+			__m128 inv_light_len = rsqrt_nr(dot3(lx, ly, lz, lx, ly, lz));
+			lx = _mm_mul_ps(lx, inv_light_len);
+			ly = _mm_mul_ps(ly, inv_light_len);
+			lz = _mm_mul_ps(lz, inv_light_len);
+		}
+
+		__m128 ndl = dot3(nxv, nyv, nzv, lx, ly, lz);
+		if (kd)
+			_mm_storeu_ps(kd + i, _mm_max_ps(zero, ndl));
+
+		if (!ks)
+			continue;
+
+		//Normalized view direction
+		__m128 vx = _mm_sub_ps(Ex, x);
+		__m128 vy = _mm_sub_ps(Ey, y);
+		__m128 vz = _mm_sub_ps(Ez, z);
+		__m128 inv_len = rsqrt_nr(dot3(vx, vy, vz, vx, vy, vz));
+		vx = _mm_mul_ps(vx, inv_len);
+		vy = _mm_mul_ps(vy, inv_len);
+		vz = _mm_mul_ps(vz, inv_len);
+
+		//Reflected light direction, r = 2n(n.l) - l
+		__m128 s = _mm_mul_ps(two, ndl);
+		__m128 rx = _mm_sub_ps(_mm_mul_ps(nxv, s), lx);
+		__m128 ry = _mm_sub_ps(_mm_mul_ps(nyv, s), ly);
+		__m128 rz = _mm_sub_ps(_mm_mul_ps(nzv, s), lz);
+
+		float rdv[4];
+		_mm_storeu_ps(rdv, _mm_max_ps(zero, dot3(rx, ry, rz, vx, vy, vz)));
+		for (int lane = 0; lane < 4; lane++) {
+			ks[i + lane] = table->lookup(rdv[lane]);
+		}
+	}
+
+	//Scalar tail with the same math
+	for (; i < n; i++) {
+		V3 P(px[i], py[i], pz[i]);
+		V3 N(nx[i], ny[i], nz[i]);
+		V3 l = light;
+		if (!directional) {
+			l = l - P;
+			l *= 1.0f / sqrtf(fmaxf(l * l, 1e-20f));
+		}
+
+		float ndl = N * l;
+		if (kd)
+			kd[i] = fmaxf(0.0f, ndl);
+
+		if (!ks)
+			continue;
+
+		V3 v = V3(eye_pos) - P;
+		v *= 1.0f / sqrtf(fmaxf(v * v, 1e-20f));
+		ks[i] = table->lookup(N.reflected(l) * v);
+	}
+}
+
+void light_terms_soa(const float* px, const float* py, const float* pz,
+	const float* nx, const float* ny, const float* nz, int n,
+	V3 light_pos, V3 eye_pos, SpecularTable* table, float* kd, float* ks) {
+	light_terms_soa_impl(px, py, pz, nx, ny, nz, n, light_pos, false, eye_pos, table, kd, ks);
+}
+
+void light_terms_directional_soa(const float* px, const float* py, const float* pz,
+	const float* nx, const float* ny, const float* nz, int n,
+	V3 to_light, V3 eye_pos, SpecularTable* table, float* kd, float* ks) {
+	light_terms_soa_impl(px, py, pz, nx, ny, nz, n, to_light, true, eye_pos, table, kd, ks);
+}
+
+void light_vertex_terms(V3* verts, V3* normals, int num_verts, ShadowMap* shadow_map,
+	V3 light_pos, V3 eye_pos, int specular_exp, float* kd, unsigned char* shadowed, float* ks) {
+
+	//Built on the calling thread, only read by the workers
+	SpecularTable* table_ptr = specular_table(specular_exp);
+
+	const int block = 64;
+
+	thread_pool()->parallel_for(num_verts, 2048, [=](int begin, int end) {
+		TraceScope trace("light_vertex_terms range");
+		float px[block], py[block], pz[block];
+		float nx[block], ny[block], nz[block];
+
+		for (int b = begin; b < end; b += block) {
+			int n = (end - b < block) ? end - b : block;
+
+			//Gather AoS vertices into SoA lanes
+			for (int i = 0; i < n; i++) {
+				float* P = verts[b + i].xyz;
+				float* N = normals[b + i].xyz;
+				px[i] = P[0];
+				py[i] = P[1];
+				pz[i] = P[2];
+				nx[i] = N[0];
+				ny[i] = N[1];
+				nz[i] = N[2];
+			}
+
+			light_terms_soa(px, py, pz, nx, ny, nz, n, light_pos, eye_pos, table_ptr,
+				kd ? kd + b : nullptr, ks ? ks + b : nullptr);
+
+			if (!kd)
+				continue;
+
+			for (int i = 0; i < n; i++) {
+				shadowed[b + i] = shadow_map && shadow_map->in_shadow(verts[b + i]);
+			}
+		}
+	});
+}
+
+void combine_lighting(V3* colors, float* kd, unsigned char* shadowed, float* ks, int num_verts,
+	float ka, V3* lighted_colors) {
+	for (int vi = 0; vi < num_verts; vi++) {
+		if (shadowed[vi]) {
+			lighted_colors[vi] = colors[vi] * ka; // ambient only
+			continue;
+		}
+		lighted_colors[vi] = colors[vi] * (ka + (1.0f - ka) * kd[vi] + ks[vi]);
+	}
+}
+
+void accumulate_lights_soa(const float* px, const float* py, const float* pz,
+	const float* nx, const float* ny, const float* nz, int n,
+	PointLight** lights, const int* light_ids, int num_ids, V3 eye_pos, SpecularTable* table,
+	float* kd_sum, float* ks_sum) {
+	float kd[max_soa_batch], ks[max_soa_batch];
+
+	for (int j = 0; j < num_ids; j++) {
+		PointLight* light = lights[light_ids[j]];
+		V3 L = light->pos;
+		float inv_r2 = light->get_inv_radius2();
+		ShadowMap* shadow_map = light->casts_shadows ? light->shadow_map : nullptr;
+
+		light_terms_soa(px, py, pz, nx, ny, nz, n, L, eye_pos, table, kd, ks);
+
+		for (int i = 0; i < n; i++) {
+			float dx = L[0] - px[i];
+			float dy = L[1] - py[i];
+			float dz = L[2] - pz[i];
+			float att = fmaxf(0.0f, 1.0f - (dx * dx + dy * dy + dz * dz) * inv_r2);
+			att *= att;
+			if (att == 0.0f)
+				continue;
+			if (shadow_map && shadow_map->in_shadow(V3(px[i], py[i], pz[i])))
+				continue;
+			kd_sum[i] += att * kd[i];
+			ks_sum[i] += att * ks[i];
+		}
+	}
+}
+
+void light_vertices_tiled(V3* verts, V3* normals, V3* colors, int num_verts,
+	PointLight** lights, int num_lights, LightGrid* grid, PPC* ppc, float ka, int specular_exp,
+	V3* lighted_colors) {
+	if (num_verts <= 0)
+		return;
+	SpecularTable* table = specular_table(specular_exp);
+	V3 eye_pos = ppc->C;
+
+	// Bucket the vertices by screen tile, bucket num_tiles holds the off screen ones
+	int num_tiles = grid->tiles_w * grid->tiles_h;
+	vector<int> vert_bucket(num_verts);
+	thread_pool()->parallel_for(num_verts, 4096, [&](int begin, int end) {
+		for (int vi = begin; vi < end; vi++) {
+			V3 PP;
+			int tile = ppc->project(verts[vi], PP) ? grid->get_tile((int)PP[0], (int)PP[1]) : -1;
+			vert_bucket[vi] = (tile < 0) ? num_tiles : tile;
+		}
+	});
+
+	vector<int> bucket_offsets(num_tiles + 2, 0);
+	for (int vi = 0; vi < num_verts; vi++) {
+		bucket_offsets[vert_bucket[vi] + 1]++;
+	}
+	for (int t = 0; t <= num_tiles; t++) {
+		bucket_offsets[t + 1] += bucket_offsets[t];
+	}
+	vector<int> order(num_verts);
+	vector<int> fill(bucket_offsets.begin(), bucket_offsets.end() - 1);
+	for (int vi = 0; vi < num_verts; vi++) {
+		order[fill[vert_bucket[vi]]++] = vi;
+	}
+
+	// Lights that reach the mesh bounding box at all, for the off screen vertices
+	V3 bmin = verts[0];
+	V3 bmax = verts[0];
+	for (int vi = 1; vi < num_verts; vi++) {
+		for (int k = 0; k < 3; k++) {
+			bmin[k] = fminf(bmin[k], verts[vi][k]);
+			bmax[k] = fmaxf(bmax[k], verts[vi][k]);
+		}
+	}
+	vector<int> mesh_lights;
+	for (int li = 0; li < num_lights; li++) {
+		float dist2 = 0.0f;
+		for (int k = 0; k < 3; k++) {
+			float e = fmaxf(0.0f, fmaxf(bmin[k] - lights[li]->pos[k], lights[li]->pos[k] - bmax[k]));
+			dist2 += e * e;
+		}
+		if (lights[li]->attenuation(dist2) > 0.0f)
+			mesh_lights.push_back(li);
+	}
+
+	thread_pool()->parallel_for(num_tiles + 1, 8, [&](int begin, int end) {
+		TraceScope trace("light_vertices_tiled range");
+		float px[max_soa_batch], py[max_soa_batch], pz[max_soa_batch];
+		float nx[max_soa_batch], ny[max_soa_batch], nz[max_soa_batch];
+		float kd[max_soa_batch], ks[max_soa_batch];
+
+		for (int t = begin; t < end; t++) {
+			int num_ids;
+			int* light_ids;
+			if (t < num_tiles) {
+				light_ids = grid->lights_in_tile(t, num_ids);
+			}
+			else {
+				light_ids = mesh_lights.data();
+				num_ids = (int)mesh_lights.size();
+			}
+
+			for (int b = bucket_offsets[t]; b < bucket_offsets[t + 1]; b += max_soa_batch) {
+				int n = min(max_soa_batch, bucket_offsets[t + 1] - b);
+
+				for (int i = 0; i < n; i++) {
+					int vi = order[b + i];
+					px[i] = verts[vi][0];
+					py[i] = verts[vi][1];
+					pz[i] = verts[vi][2];
+					nx[i] = normals[vi][0];
+					ny[i] = normals[vi][1];
+					nz[i] = normals[vi][2];
+					kd[i] = 0.0f;
+					ks[i] = 0.0f;
+				}
+
+				accumulate_lights_soa(px, py, pz, nx, ny, nz, n, lights, light_ids, num_ids,
+					eye_pos, table, kd, ks);
+
+				for (int i = 0; i < n; i++) {
+					int vi = order[b + i];
+					lighted_colors[vi] = colors[vi] * (ka + (1.0f - ka) * kd[i] + ks[i]);
+				}
+			}
+		}
+	});
+}
+
+void light_vertices_directional(V3* verts, V3* normals, V3* colors, int num_verts,
+	DirectionalShadowMap* shadow_map, V3 eye_pos, float ka, int specular_exp, V3* lighted_colors) {
+
+	SpecularTable* table_ptr = specular_table(specular_exp);
+	V3 to_light = shadow_map->dir * -1.0f;
+
+	const int block = 64;
+
+	thread_pool()->parallel_for(num_verts, 2048, [=](int begin, int end) {
+		TraceScope trace("light_vertices_directional range");
+		float px[block], py[block], pz[block];
+		float nx[block], ny[block], nz[block];
+		float kd[block], ks[block];
+
+		for (int b = begin; b < end; b += block) {
+			int n = (end - b < block) ? end - b : block;
+
+			for (int i = 0; i < n; i++) {
+				float* P = verts[b + i].xyz;
+				float* N = normals[b + i].xyz;
+				px[i] = P[0];
+				py[i] = P[1];
+				pz[i] = P[2];
+				nx[i] = N[0];
+				ny[i] = N[1];
+				nz[i] = N[2];
+			}
+
+			light_terms_directional_soa(px, py, pz, nx, ny, nz, n, to_light, eye_pos, table_ptr, kd, ks);
+
+			for (int i = 0; i < n; i++) {
+				int vi = b + i;
+				// Back facing vertices cannot be lit, so they skip the cascade lookup
+				if (kd[i] <= 0.0f || shadow_map->in_shadow(verts[vi])) {
+					lighted_colors[vi] = colors[vi] * ka; // ambient only
+					continue;
+				}
+				lighted_colors[vi] = colors[vi] * (ka + (1.0f - ka) * kd[i] + ks[i]);
+			}
+		}
+	});
+}
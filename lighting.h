@@ -0,0 +1,82 @@
+#pragma once
+
+#include "v3.h"
+
+class ShadowMap;
+class DirectionalShadowMap;
+class PointLight;
+class LightGrid;
+class PPC;
+
+const int max_soa_batch = 64; // largest n accumulate_lights_soa accepts
+
+//pow(x, specular_exp) sampled over x in [0, 1], replaces the per-vertex pow call
+class SpecularTable {
+public:
+	static const int size = 4096;
+
+	SpecularTable();
+	void set_exp(int specular_exp); //Only rebuilds when the exponent changes
+	float lookup(float x); //x is clamped to [0, 1], linear interpolation between entries
+
+private:
+	int exp;
+	float values[size + 2];
+};
+
+//Table for the calling thread, rebuilt when the exponent changes
+SpecularTable* specular_table(int specular_exp);
+
+//Light state for per-pixel lighting in the rasterizer
+struct PixelLighting {
+	V3 light_pos;
+	V3 eye_pos;
+	float ka;
+	SpecularTable* table;
+	ShadowMap* shadow_map; // null to skip the shadow test
+
+	// When grid is set, each pixel is lit by the lights of its screen tile instead of light_pos
+	PointLight** lights;
+	LightGrid* grid;
+};
+
+//Diffuse and specular terms for n points in SoA layout, 4 lanes at a time with SSE.
+//Matches V3::lighted: kd = max(0, n.l), ks = max(0, r.v)^exp with l and v normalized.
+//Either kd or ks may be null to skip that term.
+void light_terms_soa(const float* px, const float* py, const float* pz,
+	const float* nx, const float* ny, const float* nz, int n,
+	V3 light_pos, V3 eye_pos, SpecularTable* table, float* kd, float* ks);
+
+//Same as light_terms_soa for a directional light, to_light is the normalized direction toward the light
+void light_terms_directional_soa(const float* px, const float* py, const float* pz,
+	const float* nx, const float* ny, const float* nz, int n,
+	V3 to_light, V3 eye_pos, SpecularTable* table, float* kd, float* ks);
+
+//Batch replacement for calling V3::lighted per vertex, split across the shared thread pool.
+//Computes the diffuse term kd (and the shadow flag) and/or the specular term ks per vertex,
+//pass null for kd to only redo the view dependent specular term.
+//shadow_map may be null to skip the shadow test.
+void light_vertex_terms(V3* verts, V3* normals, int num_verts, ShadowMap* shadow_map,
+	V3 light_pos, V3 eye_pos, int specular_exp, float* kd, unsigned char* shadowed, float* ks);
+
+//lighted_colors = colors * (ka + (1 - ka) * kd + ks), shadowed vertices get ambient only
+void combine_lighting(V3* colors, float* kd, unsigned char* shadowed, float* ks, int num_verts,
+	float ka, V3* lighted_colors);
+
+//Adds the attenuated diffuse and specular terms of lights[light_ids[0..num_ids)] to kd_sum and ks_sum
+//for n <= max_soa_batch points in SoA layout. Shadows are tested for lights that cast them.
+void accumulate_lights_soa(const float* px, const float* py, const float* pz,
+	const float* nx, const float* ny, const float* nz, int n,
+	PointLight** lights, const int* light_ids, int num_ids, V3 eye_pos, SpecularTable* table,
+	float* kd_sum, float* ks_sum);
+
+//Multi-light version of the per-vertex lighting. Vertices are bucketed by the screen tile they
+//project to and only evaluate that tile's lights, off screen vertices use every light that
+//reaches the mesh bounding box.
+void light_vertices_tiled(V3* verts, V3* normals, V3* colors, int num_verts,
+	PointLight** lights, int num_lights, LightGrid* grid, PPC* ppc, float ka, int specular_exp,
+	V3* lighted_colors);
+
+//Per-vertex lighting from the directional light of shadow_map, shadowed vertices get ambient only
+void light_vertices_directional(V3* verts, V3* normals, V3* colors, int num_verts,
+	DirectionalShadowMap* shadow_map, V3 eye_pos, float ka, int specular_exp, V3* lighted_colors);
@@ -1,32 +1,132 @@
 #pragma once
 
 #include <ostream>
+#include <utility>
 #include "v3.h"
 
-class M33 {
+// Header only like V3. Aligned to 16 bytes, which also pads it to 48, so every row can be
+// loaded as four floats for the SSE products without reading past the matrix.
+class alignas(16) M33 {
 public:
 	V3 rows[3];
-	
-	M33();
-	M33(float scalar); //For diagonal matrices, use 1 for identity
-	M33(V3 v1, V3 v2, V3 v3);
 
-	V3& operator[](int i); //Can use V3 read/write access for each vector
-	V3 get_column(int i);
-	void set_column(int i, V3 v);
+	constexpr M33() {}
+	constexpr M33(float scalar) : rows{ V3(scalar, 0.0f, 0.0f), V3(0.0f, scalar, 0.0f), V3(0.0f, 0.0f, scalar) } {} //For diagonal matrices, use 1 for identity
+	constexpr M33(V3 v1, V3 v2, V3 v3) : rows{ v1, v2, v3 } {}
 
-	V3 operator*(V3 v);
-	M33 operator*(M33 m);
-	bool operator==(M33 m2);
-	bool operator!=(M33 m2);
+	V3& operator[](int i) { return rows[i]; } //Can use V3 read/write access for each vector
+	constexpr const V3& operator[](int i) const { return rows[i]; }
+	constexpr V3 get_column(int i) const { return V3(rows[0][i], rows[1][i], rows[2][i]); }
+	void set_column(int i, V3 v) {
+		rows[0][i] = v[0];
+		rows[1][i] = v[1];
+		rows[2][i] = v[2];
+	}
 
-	friend ostream& operator<<(ostream& ostr, M33 m);
-	friend istream& operator>>(istream& ostr, M33& m);
+	constexpr V3 operator*(const V3& v) const { return V3(rows[0] * v, rows[1] * v, rows[2] * v); }
 
-	M33 transposed();
-	M33 inverted();
+	M33 operator*(const M33& m) const {
+		M33 ret;
+#if GP_SSE
+		// Row i of the product is the rows of m weighted by row i of this. The fourth lane
+		// only ever holds the next row or the padding and is overwritten or ignored.
+		__m128 m0 = _mm_loadu_ps(m.rows[0].xyz);
+		__m128 m1 = _mm_loadu_ps(m.rows[1].xyz);
+		__m128 m2 = _mm_loadu_ps(m.rows[2].xyz);
+		for (int i = 0; i < 3; i++) {
+			__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(rows[i][0]), m0),
+				_mm_mul_ps(_mm_set1_ps(rows[i][1]), m1)), _mm_mul_ps(_mm_set1_ps(rows[i][2]), m2));
+			_mm_storeu_ps(ret.rows[i].xyz, r);
+		}
+#else
+		for (int j = 0; j < 3; j++) {
+			V3 col = m.get_column(j);
+			for (int i = 0; i < 3; i++) {
+				ret[i][j] = rows[i] * col;
+			}
+		}
+#endif
+		return ret;
+	}
 
-	void set_as_x_rotation(float degrees);
-	void set_as_y_rotation(float degrees);
-	void set_as_z_rotation(float degrees);
+	constexpr bool operator==(const M33& m2) const { return rows[0] == m2.rows[0] && rows[1] == m2.rows[1] && rows[2] == m2.rows[2]; }
+	constexpr bool operator!=(const M33& m2) const { return !(*this == m2); }
+
+	friend ostream& operator<<(ostream& ostr, const M33& m) { return ostr << m[0] << endl << m[1] << endl << m[2]; }
+	friend istream& operator>>(istream& istr, M33& m) { return istr >> m[0] >> m[1] >> m[2]; }
+
+	constexpr M33 transposed() const { return M33(get_column(0), get_column(1), get_column(2)); }
+
+	// Rows of the inverse are the cross products of the columns over the determinant, a
+	// singular matrix gives inf or NaN instead of throwing
+	M33 inverted() const {
+		V3 a = get_column(0);
+		V3 b = get_column(1);
+		V3 c = get_column(2);
+
+		V3 _a = b ^ c;
+		_a /= (a * _a);
+
+		V3 _b = c ^ a;
+		_b /= (b * _b);
+
+		V3 _c = a ^ b;
+		_c /= (c * _c);
+
+		return M33(_a, _b, _c);
+	}
+
+	void set_as_x_rotation(float degrees) {
+		float radians = degrees * (3.14159265358979f / 180.0f);
+		float c = cosf(radians);
+		float s = sinf(radians);
+		rows[0] = V3(1, 0, 0);
+		rows[1] = V3(0, c, -s);
+		rows[2] = V3(0, s, c);
+	}
+	void set_as_y_rotation(float degrees) {
+		float radians = degrees * (3.14159265358979f / 180.0f);
+		float c = cosf(radians);
+		float s = sinf(radians);
+		rows[0] = V3(c, 0, s);
+		rows[1] = V3(0, 1, 0);
+		rows[2] = V3(-s, 0, c);
+	}
+	void set_as_z_rotation(float degrees) {
+		float radians = degrees * (3.14159265358979f / 180.0f);
+		float c = cosf(radians);
+		float s = sinf(radians);
+		rows[0] = V3(c, -s, 0);
+		rows[1] = V3(s, c, 0);
+		rows[2] = V3(0, 0, 1);
+	}
 };
+
+inline V3 V3::rotate_point(V3 Oa, V3 a, float rotation_degrees) const {
+	const V3& p = *this;
+
+	V3 axis = a.normalized();
+
+	//Sets to x or y basis vector depending on which is more perpendicular to axis
+	//No need for dot product since axis is normalized and basis vectors are unit length
+	V3 temp = (fabsf(axis[0]) < fabsf(axis[1])) ? V3(1, 0, 0) : V3(0, 1, 0);
+	V3 u = (temp ^ axis).normalized();
+	V3 v = (axis ^ u).normalized();
+
+	M33 basis(u, v, axis);
+
+	// Transform and translate to new coordinate system
+	V3 p_local = basis * (p - Oa);  // transpose is inverse for orthonormal matrices
+
+	// Rotate around Z-axis in local coordinates
+	M33 rotation_matrix;
+	rotation_matrix.set_as_z_rotation(rotation_degrees);
+	V3 p_rotated = rotation_matrix * p_local;
+
+	// Transform back and translate
+	return basis.transposed() * p_rotated + Oa;
+}
+
+inline V3 V3::rotate_direction(V3 a, float rotation_degrees) const {
+	return rotate_point(V3(), a, rotation_degrees);
+}
@@ -0,0 +1,121 @@
+#include "mapped_file.h"
+
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+MappedFile::MappedFile() {
+	data = nullptr;
+	size = 0;
+	file_handle = nullptr;
+	mapping_handle = nullptr;
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(char* fname, bool copy_on_write) {
+	close();
+
+	HANDLE file = CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		cerr << "INFO: cannot open file: " << fname << endl;
+		return false;
+	}
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		cerr << "INFO: file " << fname << " is empty" << endl;
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+	if (!mapping) {
+		cerr << "ERROR: cannot map file: " << fname << endl;
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+	if (!view) {
+		cerr << "ERROR: cannot map file: " << fname << endl;
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	data = (unsigned char*)view;
+	size = (size_t)file_size.QuadPart;
+	file_handle = file;
+	mapping_handle = mapping;
+	return true;
+}
+
+void MappedFile::close() {
+	if (data)
+		UnmapViewOfFile(data);
+	if (mapping_handle)
+		CloseHandle((HANDLE)mapping_handle);
+	if (file_handle)
+		CloseHandle((HANDLE)file_handle);
+	data = nullptr;
+	size = 0;
+	file_handle = nullptr;
+	mapping_handle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(char* fname, bool copy_on_write) {
+	close();
+
+	int fd = ::open(fname, O_RDONLY);
+	if (fd < 0) {
+		cerr << "INFO: cannot open file: " << fname << endl;
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		cerr << "INFO: file " << fname << " is empty" << endl;
+		::close(fd);
+		return false;
+	}
+
+	int prot = copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ;
+	void* view = mmap(nullptr, (size_t)st.st_size, prot, MAP_PRIVATE, fd, 0);
+	::close(fd); // the mapping keeps its own reference to the file
+	if (view == MAP_FAILED) {
+		cerr << "ERROR: cannot map file: " << fname << endl;
+		return false;
+	}
+
+	data = (unsigned char*)view;
+	size = (size_t)st.st_size;
+	return true;
+}
+
+void MappedFile::close() {
+	if (data)
+		munmap(data, size);
+	data = nullptr;
+	size = 0;
+}
+
+#endif
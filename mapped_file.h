@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+
+// A whole file mapped into memory. Read-only pages are shared between every process
+// mapping the same file. With copy_on_write the mapping is also writable, and a page is
+// only copied, privately, the first time it is written to.
+class MappedFile {
+public:
+	unsigned char* data; // null when nothing is mapped
+	size_t size;
+
+	MappedFile();
+	~MappedFile();
+
+	bool open(char* fname, bool copy_on_write = false);
+	void close();
+
+private:
+	void* file_handle; // Windows only
+	void* mapping_handle; // Windows only
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+};
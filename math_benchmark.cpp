@@ -0,0 +1,373 @@
+// Microbenchmarks of the math the pipeline runs per vertex and per pixel: the V3 operators,
+// normalized and rotate_point, M33 products and inverted, Affine, PPC::project and interpolate.
+//
+// usage: MathBenchmark [-n count] [-ms time] [-op name] [-o file.json]
+//   -n inputs per batch (default 4096), -ms minimum time of a measurement (default 100)
+//   -op runs only the operations whose name starts with name, e.g. -op v3_
+//
+// Every operation is timed in two forms. scalar is a dependent chain, one call at a time with
+// a component of each result fed back into the next input (times a zero the compiler cannot
+// see), so it measures latency; batched calls it over arrays of independent inputs, the
+// throughput the vertex and pixel loops get and what vectorizing the types should improve.
+// Results are the best of 5 measurements, as ns per operation and millions of operations/s.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "affine.h"
+#include "m33.h"
+#include "ppc.h"
+#include "v3.h"
+
+using namespace std;
+
+struct MathBenchmarkOptions {
+	int count = 4096;
+	double min_ms = 100.0;
+	string op_filter;
+	string output_fname; // stdout when empty
+};
+
+struct MathResult {
+	string name;
+	double scalar_ns, batched_ns;
+};
+
+static volatile float zero = 0.0f;
+static volatile float sink;
+
+// Deterministic inputs, the same on every run and platform
+static unsigned int seed = 12345u;
+static float random_float(float lo, float hi) {
+	seed = seed * 1664525u + 1013904223u;
+	return lo + (hi - lo) * (float)(seed >> 8) / (float)(1u << 24);
+}
+
+static V3 random_unit() {
+	V3 v(random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f));
+	if (v.length() < 1e-3f)
+		return V3(1.0f, 0.0f, 0.0f);
+	return v.normalized();
+}
+
+static M33 random_rotation() {
+	M33 x, y, z;
+	x.set_as_x_rotation(random_float(0.0f, 360.0f));
+	y.set_as_y_rotation(random_float(0.0f, 360.0f));
+	z.set_as_z_rotation(random_float(0.0f, 360.0f));
+	return x * y * z;
+}
+
+// Best ns per operation of 5 measurements, body does ops_per_call operations and returns
+// something that depends on all of them
+template <typename Body>
+static double measure(Body body, int ops_per_call, double min_ms) {
+	double best_ns = 1e30;
+	for (int run = 0; run < 5; run++) {
+		long long calls = 0;
+		double ms = 0.0;
+		float total = 0.0f;
+		auto start = chrono::steady_clock::now();
+		do {
+			total += body();
+			calls++;
+			ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		} while (ms < min_ms / 5.0);
+		sink = total;
+		best_ns = min(best_ns, ms * 1e6 / ((double)calls * ops_per_call));
+	}
+	return best_ns;
+}
+
+int main(int argc, char** argv) {
+	MathBenchmarkOptions options;
+	for (int i = 1; i < argc; i++) {
+		bool has_value = i + 1 < argc;
+		if (strcmp(argv[i], "-n") == 0 && has_value) {
+			options.count = max(16, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "-ms") == 0 && has_value) {
+			options.min_ms = max(1.0, atof(argv[++i]));
+		}
+		else if (strcmp(argv[i], "-op") == 0 && has_value) {
+			options.op_filter = argv[++i];
+		}
+		else if (strcmp(argv[i], "-o") == 0 && has_value) {
+			options.output_fname = argv[++i];
+		}
+		else {
+			cerr << "usage: MathBenchmark [-n count] [-ms time] [-op name] [-o file.json]" << endl;
+			return 1;
+		}
+	}
+
+	FILE* out = stdout;
+	if (!options.output_fname.empty()) {
+		out = fopen(options.output_fname.c_str(), "w");
+		if (!out) {
+			cerr << "ERROR: cannot open " << options.output_fname << " for writing" << endl;
+			return 1;
+		}
+	}
+
+	const int n = options.count;
+	vector<V3> a(n), b(n), points(n), out_v3(n);
+	vector<float> scales(n), degrees(n), ts(n), out_float(n);
+	vector<M33> rotations(n), out_m33(n);
+	vector<PPC> out_ppc(n);
+
+	// Points spread over the view frustum of ppc, between 10 and 1000 units in front of it
+	PPC ppc(60.0f, 640, 480);
+	ppc.pose(V3(0.0f, 50.0f, 200.0f), V3(0.0f, 0.0f, 0.0f), V3(0.0f, 1.0f, 0.0f));
+	PPC ppc2(45.0f, 640, 480);
+	ppc2.pose(V3(300.0f, 20.0f, -100.0f), V3(0.0f, 10.0f, 0.0f), V3(0.0f, 1.0f, 0.0f));
+
+	for (int i = 0; i < n; i++) {
+		a[i] = random_unit();
+		b[i] = random_unit() * random_float(0.5f, 2.0f);
+		scales[i] = random_float(0.9f, 1.1f);
+		degrees[i] = random_float(-180.0f, 180.0f);
+		ts[i] = random_float(0.01f, 0.99f);
+		rotations[i] = random_rotation();
+
+		float u = random_float(0.0f, (float)ppc.w);
+		float v = random_float(0.0f, (float)ppc.h);
+		points[i] = ppc.C + (ppc.c + u * ppc.a + v * ppc.b) * random_float(10.0f, 1000.0f);
+	}
+
+	vector<MathResult> results;
+	auto run = [&](const char* name, auto scalar, auto batched) {
+		if (!options.op_filter.empty() && strncmp(name, options.op_filter.c_str(), options.op_filter.size()) != 0)
+			return;
+		MathResult result;
+		result.name = name;
+		result.scalar_ns = measure(scalar, n, options.min_ms);
+		result.batched_ns = measure(batched, n, options.min_ms);
+		cerr << "INFO: " << name << ": " << result.scalar_ns << " ns scalar, " << result.batched_ns << " ns batched" << endl;
+		results.push_back(result);
+	};
+
+	float k = zero;
+
+	run("v3_add",
+		[&] {
+			V3 r;
+			for (int i = 0; i < n; i++) {
+				V3 in = a[i];
+				in[0] += r[0] * k;
+				r = in + b[i];
+			}
+			return r[0];
+		},
+		[&] {
+			for (int i = 0; i < n; i++) {
+				out_v3[i] = a[i] + b[i];
+			}
+			return out_v3[n / 2][0];
+		});
+
+	run("v3_dot",
+		[&] {
+			float r = 0.0f;
+			for (int i = 0; i < n; i++) {
+				V3 in = a[i];
+				in[0] += r * k;
+				r = in * b[i];
+			}
+			return r;
+		},
+		[&] {
+			for (int i = 0; i < n; i++) {
+				out_float[i] = a[i] * b[i];
+			}
+			return out_float[n / 2];
+		});
+
+	run("v3_scale",
+		[&] {
+			V3 r;
+			for (int i = 0; i < n; i++) {
+				V3 in = a[i];
+				in[0] += r[0] * k;
+				r = in * scales[i];
+			}
+			return r[0];
+		},
+		[&] {
+			for (int i = 0; i < n; i++) {
+				out_v3[i] = a[i] * scales[i];
+			}
+			return out_v3[n / 2][0];
+		});
+
+	run("v3_cross",
+		[&] {
+			V3 r;
+			for (int i = 0; i < n; i++) {
+				V3 in = a[i];
+				in[0] += r[0] * k;
+				r = in ^ b[i];
+			}
+			return r[0];
+		},
+		[&] {
+			for (int i = 0; i < n; i++) {
+				out_v3[i] = a[i] ^ b[i];
+			}
+			return out_v3[n / 2][0];
+		});
+
+	run("v3_normalized",
+		[&] {
+			V3 r;
+			for (int i = 0; i < n; i++) {
+				V3 in = b[i];
+				in[0] += r[0] * k;
+				r = in.normalized();
+			}
+			return r[0];
+		},
+		[&] {
+			for (int i = 0; i < n; i++) {
+				out_v3[i] = b[i].normalized();
+			}
+			return out_v3[n / 2][0];
+		});
+
+	run("v3_rotate_point",
+		[&] {
+			V3 r;
+			for (int i = 0; i < n; i++) {
+				V3 in = points[i];
+				in[0] += r[0] * k;
+				r = in.rotate_point(b[i], a[i], degrees[i]);
+			}
+			return r[0];
+		},
+		[&] {
+			for (int i = 0; i < n; i++) {
+				out_v3[i] = points[i].rotate_point(b[i], a[i], degrees[i]);
+			}
+			return out_v3[n / 2][0];
+		});
+
+	run("m33_mul_v3",
+		[&] {
+			V3 r;
+			for (int i = 0; i < n; i++) {
+				V3 in = b[i];
+				in[0] += r[0] * k;
+				r = rotations[i] * in;
+			}
+			return r[0];
+		},
+		[&] {
+			for (int i = 0; i < n; i++) {
+				out_v3[i] = rotations[i] * b[i];
+			}
+			return out_v3[n / 2][0];
+		});
+
+	run("m33_mul_m33",
+		[&] {
+			M33 r(1.0f);
+			for (int i = 0; i < n; i++) {
+				M33 in = rotations[i];
+				in[0][0] += r[0][0] * k;
+				r = in * rotations[n - 1 - i];
+			}
+			return r[0][0];
+		},
+		[&] {
+			for (int i = 0; i < n; i++) {
+				out_m33[i] = rotations[i] * rotations[n - 1 - i];
+			}
+			return out_m33[n / 2][0][0];
+		});
+
+	run("m33_inverted",
+		[&] {
+			M33 r(1.0f);
+			for (int i = 0; i < n; i++) {
+				M33 in = rotations[i];
+				in[0][0] += r[0][0] * k;
+				r = in.inverted();
+			}
+			return r[0][0];
+		},
+		[&] {
+			for (int i = 0; i < n; i++) {
+				out_m33[i] = rotations[i].inverted();
+			}
+			return out_m33[n / 2][0][0];
+		});
+
+	// What TM::rotate_about_arbitrary_axis does per vertex now, against v3_rotate_point above
+	Affine xf = Affine::make_rotation(b[0], a[0], degrees[0]);
+	run("affine_transform_point",
+		[&] {
+			V3 r;
+			for (int i = 0; i < n; i++) {
+				V3 in = points[i];
+				in[0] += r[0] * k;
+				r = xf.transform_point(in);
+			}
+			return r[0];
+		},
+		[&] {
+			memcpy(out_v3.data(), points.data(), sizeof(V3) * n);
+			xf.transform_array(out_v3.data(), n, true);
+			return out_v3[n / 2][0];
+		});
+
+	run("ppc_project",
+		[&] {
+			V3 r;
+			for (int i = 0; i < n; i++) {
+				V3 in = points[i];
+				in[0] += r[0] * k;
+				ppc.project(in, r);
+			}
+			return r[0];
+		},
+		[&] {
+			for (int i = 0; i < n; i++) {
+				ppc.project(points[i], out_v3[i]);
+			}
+			return out_v3[n / 2][0];
+		});
+
+	run("ppc_interpolate",
+		[&] {
+			PPC r;
+			for (int i = 0; i < n; i++) {
+				r = ppc.interpolate(&ppc2, ts[i] + r.C[0] * k);
+			}
+			return r.C[0];
+		},
+		[&] {
+			for (int i = 0; i < n; i++) {
+				out_ppc[i] = ppc.interpolate(&ppc2, ts[i]);
+			}
+			return out_ppc[n / 2].C[0];
+		});
+
+	fprintf(out, "{\n");
+	fprintf(out, "  \"count\": %d,\n  \"min_ms\": %.1f,\n", n, options.min_ms);
+	fprintf(out, "  \"ops\": [");
+	for (size_t i = 0; i < results.size(); i++) {
+		const MathResult& r = results[i];
+		fprintf(out, "%s\n    {\"name\": \"%s\", \"scalar_ns\": %.3f, \"batched_ns\": %.3f, \"scalar_mops_per_s\": %.1f, \"batched_mops_per_s\": %.1f}",
+			i ? "," : "", r.name.c_str(), r.scalar_ns, r.batched_ns, 1e3 / r.scalar_ns, 1e3 / r.batched_ns);
+	}
+	fprintf(out, "\n  ]\n}\n");
+	if (out != stdout)
+		fclose(out);
+	return 0;
+}
@@ -0,0 +1,397 @@
+#include "mesh_bake.h"
+#include "mesh_file.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+using namespace std;
+
+bool read_bin_mesh(char* fname, MeshData& mesh) {
+	ifstream ifs(fname, ios::binary);
+	if (ifs.fail()) {
+		cerr << "INFO: cannot open file: " << fname << endl;
+		return false;
+	}
+
+	int num_verts = 0;
+	ifs.read((char*)&num_verts, sizeof(int));
+	if (num_verts <= 0) {
+		cerr << "INFO: file " << fname << " has no vertices" << endl;
+		return false;
+	}
+
+	char yn[4]; // xyz, rgb, normals, texture coordinates
+	ifs.read(yn, 4);
+	if (yn[0] != 'y') {
+		cerr << "ERROR: file " << fname << " has no vertex xyz data" << endl;
+		return false;
+	}
+
+	mesh.verts.resize(num_verts);
+	ifs.read((char*)mesh.verts.data(), num_verts * 3 * sizeof(float));
+
+	mesh.colors.clear();
+	if (yn[1] == 'y') {
+		mesh.colors.resize(num_verts);
+		ifs.read((char*)mesh.colors.data(), num_verts * 3 * sizeof(float));
+	}
+
+	mesh.normals.clear();
+	if (yn[2] == 'y') {
+		mesh.normals.resize(num_verts);
+		ifs.read((char*)mesh.normals.data(), num_verts * 3 * sizeof(float));
+	}
+
+	mesh.tcs.clear();
+	if (yn[3] == 'y') {
+		vector<float> file_tcs(num_verts * 2);
+		ifs.read((char*)file_tcs.data(), num_verts * 2 * sizeof(float));
+		mesh.tcs.resize(num_verts);
+		for (int vi = 0; vi < num_verts; vi++) {
+			mesh.tcs[vi] = V3(file_tcs[vi * 2 + 0], file_tcs[vi * 2 + 1], 0.0f);
+		}
+	}
+
+	int num_tris = 0;
+	ifs.read((char*)&num_tris, sizeof(int));
+	if (ifs.fail() || num_tris <= 0) {
+		cerr << "ERROR: file " << fname << " has no triangles" << endl;
+		return false;
+	}
+	mesh.tris.resize(num_tris * 3);
+	ifs.read((char*)mesh.tris.data(), num_tris * 3 * sizeof(unsigned int));
+	if (ifs.fail()) {
+		cerr << "ERROR: file " << fname << " is truncated" << endl;
+		return false;
+	}
+
+	for (unsigned int vi : mesh.tris) {
+		if (vi >= (unsigned int)num_verts) {
+			cerr << "ERROR: file " << fname << " has a vertex index out of range" << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool write_mesh_file(char* fname, MeshData& mesh, bool allow_16bit_indices) {
+	return MeshFile::write(fname, mesh.verts.data(),
+		mesh.colors.empty() ? nullptr : mesh.colors.data(),
+		mesh.normals.empty() ? nullptr : mesh.normals.data(),
+		mesh.tcs.empty() ? nullptr : mesh.tcs.data(),
+		mesh.num_verts(), mesh.tris.data(), mesh.num_tris(), allow_16bit_indices);
+}
+
+static bool close_enough(V3 a, V3 b, float epsilon) {
+	return fabsf(a[0] - b[0]) <= epsilon && fabsf(a[1] - b[1]) <= epsilon && fabsf(a[2] - b[2]) <= epsilon;
+}
+
+int weld_vertices(MeshData& mesh, float epsilon) {
+	int num_verts = mesh.num_verts();
+	bool has_colors = !mesh.colors.empty();
+	bool has_normals = !mesh.normals.empty();
+	bool has_tcs = !mesh.tcs.empty();
+
+	// Vertices are bucketed by their position snapped to an epsilon grid. Duplicates
+	// straddling a cell boundary are missed, which only costs a vertex, never correctness.
+	float inv_cell = 1.0f / fmaxf(epsilon, 1e-12f);
+	auto cell_key = [&](V3 P) {
+		uint64_t x = (uint64_t)(int64_t)floorf(P[0] * inv_cell) & 0x1FFFFF;
+		uint64_t y = (uint64_t)(int64_t)floorf(P[1] * inv_cell) & 0x1FFFFF;
+		uint64_t z = (uint64_t)(int64_t)floorf(P[2] * inv_cell) & 0x1FFFFF;
+		return (x << 42) | (y << 21) | z;
+	};
+
+	unordered_multimap<uint64_t, int> cells;
+	cells.reserve(num_verts);
+	vector<int> remap(num_verts);
+	int num_unique = 0;
+
+	for (int vi = 0; vi < num_verts; vi++) {
+		uint64_t key = cell_key(mesh.verts[vi]);
+		int match = -1;
+		auto range = cells.equal_range(key);
+		for (auto it = range.first; it != range.second; it++) {
+			int ui = it->second;
+			if (close_enough(mesh.verts[vi], mesh.verts[ui], epsilon) &&
+				(!has_colors || close_enough(mesh.colors[vi], mesh.colors[ui], epsilon)) &&
+				(!has_normals || close_enough(mesh.normals[vi], mesh.normals[ui], epsilon)) &&
+				(!has_tcs || close_enough(mesh.tcs[vi], mesh.tcs[ui], epsilon))) {
+				match = ui;
+				break;
+			}
+		}
+
+		if (match >= 0) {
+			remap[vi] = remap[match];
+			continue;
+		}
+
+		// Unique vertices are compacted in place, remap[ui] of a kept vertex is its new index
+		remap[vi] = num_unique;
+		cells.insert(make_pair(key, vi));
+		num_unique++;
+	}
+
+	// Keep the first occurrence of each vertex
+	vector<bool> kept(num_verts, false);
+	for (int vi = 0; vi < num_verts; vi++) {
+		int ni = remap[vi];
+		if (kept[ni])
+			continue;
+		kept[ni] = true;
+		mesh.verts[ni] = mesh.verts[vi];
+		if (has_colors)
+			mesh.colors[ni] = mesh.colors[vi];
+		if (has_normals)
+			mesh.normals[ni] = mesh.normals[vi];
+		if (has_tcs)
+			mesh.tcs[ni] = mesh.tcs[vi];
+	}
+	mesh.verts.resize(num_unique);
+	if (has_colors)
+		mesh.colors.resize(num_unique);
+	if (has_normals)
+		mesh.normals.resize(num_unique);
+	if (has_tcs)
+		mesh.tcs.resize(num_unique);
+
+	// Drop triangles that collapsed to a line or a point
+	int num_tris = mesh.num_tris();
+	int kept_tris = 0;
+	for (int ti = 0; ti < num_tris; ti++) {
+		unsigned int v0 = remap[mesh.tris[ti * 3 + 0]];
+		unsigned int v1 = remap[mesh.tris[ti * 3 + 1]];
+		unsigned int v2 = remap[mesh.tris[ti * 3 + 2]];
+		if (v0 == v1 || v1 == v2 || v0 == v2)
+			continue;
+		mesh.tris[kept_tris * 3 + 0] = v0;
+		mesh.tris[kept_tris * 3 + 1] = v1;
+		mesh.tris[kept_tris * 3 + 2] = v2;
+		kept_tris++;
+	}
+	mesh.tris.resize(kept_tris * 3);
+
+	return num_verts - num_unique;
+}
+
+void generate_normals(V3* verts, int num_verts, unsigned int* tris, int num_tris, V3* normals) {
+	for (int vi = 0; vi < num_verts; vi++) {
+		normals[vi] = V3(0.0f, 0.0f, 0.0f);
+	}
+
+	// The cross product's length is twice the triangle area, so summing it weights by area
+	for (int ti = 0; ti < num_tris; ti++) {
+		unsigned int v0 = tris[ti * 3 + 0];
+		unsigned int v1 = tris[ti * 3 + 1];
+		unsigned int v2 = tris[ti * 3 + 2];
+		V3 face_normal = (verts[v1] - verts[v0]) ^ (verts[v2] - verts[v0]);
+		normals[v0] = normals[v0] + face_normal;
+		normals[v1] = normals[v1] + face_normal;
+		normals[v2] = normals[v2] + face_normal;
+	}
+
+	for (int vi = 0; vi < num_verts; vi++) {
+		float len = normals[vi].length();
+		if (len > 0.0f)
+			normals[vi] = normals[vi] * (1.0f / len);
+		else
+			normals[vi] = V3(0.0f, 1.0f, 0.0f); // unused or only in degenerate triangles
+	}
+}
+
+// Forsyth's vertex scoring, see "Linear-Speed Vertex Cache Optimisation"
+static const int forsyth_cache_size = vertex_cache_size;
+
+static float forsyth_vertex_score(int cache_pos, int remaining_tris) {
+	if (remaining_tris == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cache_pos >= 0) {
+		if (cache_pos < 3) {
+			score = 0.75f; // the last triangle's vertices, fixed so its neighbors do not win outright
+		}
+		else {
+			float t = 1.0f - (float)(cache_pos - 3) / (float)(forsyth_cache_size - 3);
+			score = powf(t, 1.5f);
+		}
+	}
+
+	// Favor vertices with few triangles left, to finish them off
+	score += 2.0f / sqrtf((float)remaining_tris);
+	return score;
+}
+
+bool optimize_vertex_order(MeshData& mesh) {
+	int num_verts = mesh.num_verts();
+	int num_tris = mesh.num_tris();
+	if (num_tris == 0)
+		return false;
+
+	// Triangles around each vertex, as offsets into vert_tris
+	vector<int> vert_offsets(num_verts + 1, 0);
+	for (unsigned int vi : mesh.tris) {
+		vert_offsets[vi + 1]++;
+	}
+	for (int vi = 0; vi < num_verts; vi++) {
+		vert_offsets[vi + 1] += vert_offsets[vi];
+	}
+	vector<int> vert_tris(num_tris * 3);
+	vector<int> fill(vert_offsets.begin(), vert_offsets.end() - 1);
+	for (int ti = 0; ti < num_tris; ti++) {
+		for (int k = 0; k < 3; k++) {
+			vert_tris[fill[mesh.tris[ti * 3 + k]]++] = ti;
+		}
+	}
+
+	vector<int> remaining(num_verts);
+	vector<int> cache_pos(num_verts, -1);
+	vector<float> vert_score(num_verts);
+	for (int vi = 0; vi < num_verts; vi++) {
+		remaining[vi] = vert_offsets[vi + 1] - vert_offsets[vi];
+		vert_score[vi] = forsyth_vertex_score(-1, remaining[vi]);
+	}
+
+	vector<float> tri_score(num_tris);
+	vector<bool> added(num_tris, false);
+	for (int ti = 0; ti < num_tris; ti++) {
+		tri_score[ti] = vert_score[mesh.tris[ti * 3 + 0]] + vert_score[mesh.tris[ti * 3 + 1]] +
+			vert_score[mesh.tris[ti * 3 + 2]];
+	}
+
+	vector<unsigned int> new_tris;
+	new_tris.reserve(num_tris * 3);
+	vector<int> cache;
+	cache.reserve(forsyth_cache_size + 3);
+	int scan_start = 0; // every triangle before this one has been added
+
+	int best_tri = -1;
+	for (int n = 0; n < num_tris; n++) {
+		if (best_tri < 0) {
+			// Nothing adjacent to the cache is left, fall back to the best remaining triangle
+			float best_score = -FLT_MAX;
+			while (scan_start < num_tris && added[scan_start]) {
+				scan_start++;
+			}
+			for (int ti = scan_start; ti < num_tris; ti++) {
+				if (!added[ti] && tri_score[ti] > best_score) {
+					best_score = tri_score[ti];
+					best_tri = ti;
+				}
+			}
+		}
+
+		added[best_tri] = true;
+		unsigned int* tri = &mesh.tris[best_tri * 3];
+
+		// Move the triangle's vertices to the front of the LRU cache
+		for (int k = 0; k < 3; k++) {
+			new_tris.push_back(tri[k]);
+			remaining[tri[k]]--;
+			auto it = find(cache.begin(), cache.end(), (int)tri[k]);
+			if (it != cache.end())
+				cache.erase(it);
+		}
+		cache.insert(cache.begin(), { (int)tri[0], (int)tri[1], (int)tri[2] });
+
+		// Vertices pushed out of the cache lose their cache bonus
+		while ((int)cache.size() > forsyth_cache_size) {
+			int vi = cache.back();
+			cache.pop_back();
+			cache_pos[vi] = -1;
+			vert_score[vi] = forsyth_vertex_score(-1, remaining[vi]);
+			for (int i = vert_offsets[vi]; i < vert_offsets[vi + 1]; i++) {
+				int ti = vert_tris[i];
+				if (!added[ti]) {
+					unsigned int* t = &mesh.tris[ti * 3];
+					tri_score[ti] = vert_score[t[0]] + vert_score[t[1]] + vert_score[t[2]];
+				}
+			}
+		}
+
+		// Rescore the cached vertices and pick the best triangle touching them
+		for (int i = 0; i < (int)cache.size(); i++) {
+			int vi = cache[i];
+			cache_pos[vi] = i;
+			vert_score[vi] = forsyth_vertex_score(i, remaining[vi]);
+		}
+
+		best_tri = -1;
+		float best_score = -FLT_MAX;
+		for (int vi : cache) {
+			for (int i = vert_offsets[vi]; i < vert_offsets[vi + 1]; i++) {
+				int ti = vert_tris[i];
+				if (added[ti])
+					continue;
+				unsigned int* t = &mesh.tris[ti * 3];
+				tri_score[ti] = vert_score[t[0]] + vert_score[t[1]] + vert_score[t[2]];
+				if (tri_score[ti] > best_score) {
+					best_score = tri_score[ti];
+					best_tri = ti;
+				}
+			}
+		}
+	}
+
+	// Greedy scoring can lose to meshes that were already exported in a good order
+	if (average_cache_miss_ratio(new_tris.data(), num_tris) >= average_cache_miss_ratio(mesh.tris.data(), num_tris))
+		return false;
+
+	// Renumber vertices in first use order so vertex fetches walk memory forward
+	vector<int> new_index(num_verts, -1);
+	int next_index = 0;
+	for (unsigned int& vi : new_tris) {
+		if (new_index[vi] < 0)
+			new_index[vi] = next_index++;
+		vi = new_index[vi];
+	}
+	for (int vi = 0; vi < num_verts; vi++) {
+		if (new_index[vi] < 0)
+			new_index[vi] = next_index++; // unreferenced, kept at the end
+	}
+
+	auto reorder = [&](vector<V3>& attribute) {
+		if (attribute.empty())
+			return;
+		vector<V3> reordered(num_verts);
+		for (int vi = 0; vi < num_verts; vi++) {
+			reordered[new_index[vi]] = attribute[vi];
+		}
+		attribute.swap(reordered);
+	};
+	reorder(mesh.verts);
+	reorder(mesh.colors);
+	reorder(mesh.normals);
+	reorder(mesh.tcs);
+	mesh.tris.swap(new_tris);
+	return true;
+}
+
+float average_cache_miss_ratio(const unsigned int* tris, int num_tris, int cache_size) {
+	if (num_tris == 0)
+		return 0.0f;
+
+	// Same cache as optimize_vertex_order: a hit moves the vertex to the front
+	vector<unsigned int> lru;
+	lru.reserve(cache_size + 1);
+	int misses = 0;
+	for (int i = 0; i < num_tris * 3; i++) {
+		auto it = find(lru.begin(), lru.end(), tris[i]);
+		if (it != lru.end()) {
+			lru.erase(it);
+		}
+		else {
+			misses++;
+			if ((int)lru.size() == cache_size)
+				lru.pop_back();
+		}
+		lru.insert(lru.begin(), tris[i]);
+	}
+	return (float)misses / (float)num_tris;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+#include "v3.h"
+
+// Mesh in plain arrays, independent of TM and the GUI so offline tools can use it
+struct MeshData {
+	std::vector<V3> verts;
+	std::vector<V3> colors; // empty when absent, same for normals and tcs
+	std::vector<V3> normals;
+	std::vector<V3> tcs;
+	std::vector<unsigned int> tris; // triples of vertex indices
+
+	int num_verts() { return (int)verts.size(); }
+	int num_tris() { return (int)tris.size() / 3; }
+};
+
+bool read_bin_mesh(char* fname, MeshData& mesh); // the .bin format read by TM::load_bin
+bool write_mesh_file(char* fname, MeshData& mesh, bool allow_16bit_indices);
+
+// Merges vertices whose attributes all match within epsilon and drops triangles that
+// collapse, returns the number of vertices removed
+int weld_vertices(MeshData& mesh, float epsilon);
+
+// Area weighted average of the face normals around each vertex
+void generate_normals(V3* verts, int num_verts, unsigned int* tris, int num_tris, V3* normals);
+
+// LRU cache size the optimizer models and the miss ratio is measured with
+const int vertex_cache_size = 32;
+
+// Reorders triangles for post-transform vertex cache hits (Forsyth's linear speed
+// algorithm), then renumbers vertices in the order they are first used. Returns false and
+// leaves the mesh as it was when the new order would not miss less than the input order.
+bool optimize_vertex_order(MeshData& mesh);
+
+// Average cache miss ratio, vertices transformed per triangle with an LRU cache of cache_size
+float average_cache_miss_ratio(const unsigned int* tris, int num_tris, int cache_size = vertex_cache_size);
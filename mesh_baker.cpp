@@ -0,0 +1,148 @@
+// Offline mesh baking tool. Converts .bin meshes into optimized .gpm mesh files:
+// welds duplicate vertices, generates missing normals, reorders triangles and
+// vertices for the vertex cache and records the bounds.
+//
+// usage: MeshBaker [-o output_dir] [-32] [-q] [-chunks n] [-weld epsilon] mesh.bin ...
+//   -q writes the QuantizedMesh encoding
+//   -chunks n writes an n by n chunked .gpc file for StreamingMesh instead
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "chunked_mesh.h"
+#include "mesh_bake.h"
+#include "mesh_file.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+struct BakeOptions {
+	string output_dir; // next to the input when empty
+	bool allow_16bit_indices = true;
+	bool quantize = false;
+	int chunks = 0; // grid size of a chunked output, 0 for a .gpm file
+	float weld_epsilon = 1e-6f;
+};
+
+static string output_path(const string& input, const string& output_dir, const char* extension) {
+	string path = input;
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	if (dot != string::npos && (slash == string::npos || dot > slash))
+		path = path.substr(0, dot);
+	path += extension;
+
+	if (output_dir.empty())
+		return path;
+	string name = (slash == string::npos) ? path : path.substr(slash + 1);
+	return output_dir + "/" + name;
+}
+
+static bool bake(const string& input, const BakeOptions& options, string& report) {
+	auto start = chrono::steady_clock::now();
+	ostringstream out;
+
+	MeshData mesh;
+	if (!read_bin_mesh((char*)input.c_str(), mesh)) {
+		report = "ERROR: failed to read " + input + "\n";
+		return false;
+	}
+
+	int verts_in = mesh.num_verts();
+	int welded = weld_vertices(mesh, options.weld_epsilon);
+
+	bool generated_normals = mesh.normals.empty();
+	if (generated_normals) {
+		mesh.normals.resize(mesh.num_verts());
+		generate_normals(mesh.verts.data(), mesh.num_verts(), mesh.tris.data(), mesh.num_tris(), mesh.normals.data());
+	}
+
+	float acmr_in = average_cache_miss_ratio(mesh.tris.data(), mesh.num_tris());
+	bool reordered = optimize_vertex_order(mesh);
+	float acmr_out = average_cache_miss_ratio(mesh.tris.data(), mesh.num_tris());
+
+	string output = output_path(input, options.output_dir, options.chunks > 0 ? ".gpc" : ".gpm");
+	bool written;
+	if (options.chunks > 0) {
+		written = write_chunked_mesh((char*)output.c_str(), mesh, options.chunks, options.chunks);
+	}
+	else if (options.quantize) {
+		QuantizedMesh quantized;
+		quantized.encode(mesh.verts.data(), mesh.colors.empty() ? nullptr : mesh.colors.data(), mesh.normals.data(),
+			mesh.num_verts(), mesh.tris.data(), mesh.num_tris());
+		written = MeshFile::write_quantized((char*)output.c_str(), &quantized, mesh.tcs.empty() ? nullptr : mesh.tcs.data());
+	}
+	else {
+		written = write_mesh_file((char*)output.c_str(), mesh, options.allow_16bit_indices);
+	}
+	if (!written) {
+		report = "ERROR: failed to write " + output + "\n";
+		return false;
+	}
+
+	float ms = chrono::duration<float, milli>(chrono::steady_clock::now() - start).count();
+	out << "INFO: " << input << " -> " << output << " (" << ms << " ms)" << endl;
+	out << "      " << verts_in << " -> " << mesh.num_verts() << " verts (" << welded << " welded), "
+		<< mesh.num_tris() << " tris" << (generated_normals ? ", generated normals" : "") << endl;
+	out << "      ACMR " << acmr_in << " -> " << acmr_out << (reordered ? "" : ", kept the input order") << endl;
+	report = out.str();
+	return true;
+}
+
+int main(int argc, char** argv) {
+	BakeOptions options;
+	vector<string> inputs;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			options.output_dir = argv[++i];
+		}
+		else if (strcmp(argv[i], "-32") == 0) {
+			options.allow_16bit_indices = false;
+		}
+		else if (strcmp(argv[i], "-q") == 0) {
+			options.quantize = true;
+		}
+		else if (strcmp(argv[i], "-chunks") == 0 && i + 1 < argc) {
+			options.chunks = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-weld") == 0 && i + 1 < argc) {
+			options.weld_epsilon = (float)atof(argv[++i]);
+		}
+		else {
+			inputs.push_back(argv[i]);
+		}
+	}
+
+	if (inputs.empty()) {
+		cerr << "usage: " << argv[0] << " [-o output_dir] [-32] [-q] [-chunks n] [-weld epsilon] mesh.bin ..." << endl;
+		return 1;
+	}
+
+	auto start = chrono::steady_clock::now();
+	mutex report_mtx;
+	int num_failed = 0;
+
+	// One file per task, the reports are printed whole so they do not interleave
+	thread_pool()->parallel_for((int)inputs.size(), 1, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			string report;
+			bool ok = bake(inputs[i], options, report);
+			lock_guard<mutex> lock(report_mtx);
+			cerr << report;
+			if (!ok)
+				num_failed++;
+		}
+	});
+
+	float seconds = chrono::duration<float>(chrono::steady_clock::now() - start).count();
+	cerr << "INFO: baked " << inputs.size() - num_failed << " of " << inputs.size() << " meshes in "
+		<< seconds << " s" << endl;
+	return num_failed ? 1 : 0;
+}
@@ -0,0 +1,267 @@
+#include "mesh_file.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// Streams are used in place as V3 arrays
+static_assert(sizeof(V3) == 3 * sizeof(float), "V3 must be three packed floats");
+
+static uint64_t align_offset(uint64_t offset) {
+	return (offset + mesh_file_alignment - 1) / mesh_file_alignment * mesh_file_alignment;
+}
+
+MeshFile::MeshFile() {
+	header = nullptr;
+}
+
+bool MeshFile::check_stream(char* fname, const char* name, uint64_t offset, uint64_t bytes) {
+	if (offset == 0)
+		return true;
+	if (offset % mesh_file_alignment != 0 || offset > file.size || bytes > file.size - offset) {
+		cerr << "ERROR: " << name << " stream of " << fname << " is outside the file" << endl;
+		return false;
+	}
+	return true;
+}
+
+bool MeshFile::open(char* fname) {
+	header = nullptr;
+	if (!file.open(fname, true))
+		return false;
+
+	if (file.size < sizeof(MeshFileHeader)) {
+		cerr << "ERROR: file " << fname << " is too small to be a mesh file" << endl;
+		file.close();
+		return false;
+	}
+
+	MeshFileHeader* h = (MeshFileHeader*)file.data;
+	if (h->magic != mesh_file_magic) {
+		cerr << "ERROR: file " << fname << " is not a mesh file" << endl;
+		file.close();
+		return false;
+	}
+	if (h->version < 1 || h->version > mesh_file_version || h->header_size < sizeof(MeshFileHeader)) {
+		cerr << "ERROR: mesh file " << fname << " has unsupported version " << h->version << endl;
+		file.close();
+		return false;
+	}
+
+	uint64_t n = (uint64_t)h->num_verts;
+	bool quantized = (h->flags & MESH_FILE_QUANTIZED) != 0;
+	uint64_t index_bytes = (uint64_t)h->num_tris * 3 *
+		((h->flags & MESH_FILE_INDICES_16) ? sizeof(unsigned short) : sizeof(unsigned int));
+
+	bool valid = h->verts_offset != 0 && h->num_verts > 0 && h->tris_offset != 0 &&
+		check_stream(fname, "verts", h->verts_offset, quantized ? n * 3 * sizeof(unsigned short) : n * sizeof(V3)) &&
+		check_stream(fname, "colors", h->colors_offset, quantized ? n * 4 : n * sizeof(V3)) &&
+		check_stream(fname, "normals", h->normals_offset, quantized ? n * 2 * sizeof(short) : n * sizeof(V3)) &&
+		check_stream(fname, "tcs", h->tcs_offset, n * sizeof(V3)) &&
+		check_stream(fname, "tris", h->tris_offset, index_bytes);
+
+	// One pass over the indices here so rasterizing never has to check them
+	if (valid) {
+		uint64_t num_indices = (uint64_t)h->num_tris * 3;
+		uint32_t max_index = 0;
+		if (h->flags & MESH_FILE_INDICES_16) {
+			unsigned short* tris = (unsigned short*)(file.data + h->tris_offset);
+			for (uint64_t i = 0; i < num_indices; i++) {
+				max_index = max(max_index, (uint32_t)tris[i]);
+			}
+		}
+		else {
+			unsigned int* tris = (unsigned int*)(file.data + h->tris_offset);
+			for (uint64_t i = 0; i < num_indices; i++) {
+				max_index = max(max_index, (uint32_t)tris[i]);
+			}
+		}
+		valid = num_indices == 0 || max_index < h->num_verts;
+		if (!valid)
+			cerr << "ERROR: tris stream of " << fname << " has index " << max_index << " past the last vertex" << endl;
+	}
+	if (!valid) {
+		cerr << "ERROR: mesh file " << fname << " is corrupt" << endl;
+		file.close();
+		return false;
+	}
+
+	header = h;
+	return true;
+}
+
+void* MeshFile::get_stream(uint64_t offset) {
+	if (!header || offset == 0)
+		return nullptr;
+	return file.data + offset;
+}
+
+V3* MeshFile::get_verts() {
+	return is_quantized() ? nullptr : (V3*)get_stream(header ? header->verts_offset : 0);
+}
+
+V3* MeshFile::get_colors() {
+	return is_quantized() ? nullptr : (V3*)get_stream(header ? header->colors_offset : 0);
+}
+
+V3* MeshFile::get_normals() {
+	return is_quantized() ? nullptr : (V3*)get_stream(header ? header->normals_offset : 0);
+}
+
+V3* MeshFile::get_tcs() {
+	return (V3*)get_stream(header ? header->tcs_offset : 0);
+}
+
+void* MeshFile::get_tris() {
+	return get_stream(header ? header->tris_offset : 0);
+}
+
+bool MeshFile::has_16bit_indices() {
+	return header && (header->flags & MESH_FILE_INDICES_16);
+}
+
+bool MeshFile::is_quantized() {
+	return header && (header->flags & MESH_FILE_QUANTIZED);
+}
+
+bool MeshFile::get_quantized(QuantizedMesh* mesh) {
+	if (!is_quantized())
+		return false;
+
+	mesh->num_verts = (int)header->num_verts;
+	mesh->num_tris = (int)header->num_tris;
+	mesh->set_bounds(V3(header->bounds_min[0], header->bounds_min[1], header->bounds_min[2]),
+		V3(header->bounds_max[0], header->bounds_max[1], header->bounds_max[2]));
+	mesh->positions = (unsigned short*)get_stream(header->verts_offset);
+	mesh->colors = (unsigned char*)get_stream(header->colors_offset);
+	mesh->normals = (short*)get_stream(header->normals_offset);
+	mesh->tris = get_stream(header->tris_offset);
+	mesh->indices_16 = has_16bit_indices();
+	mesh->owns_streams = false;
+	return true;
+}
+
+// Lays out the present streams after the header, fills in their offsets and writes the file
+static bool write_streams(char* fname, MeshFileHeader& h, const void* stream_data[5], uint64_t stream_bytes[5]) {
+	uint64_t* offsets[5] = { &h.verts_offset, &h.colors_offset, &h.normals_offset, &h.tcs_offset, &h.tris_offset };
+
+	uint64_t offset = align_offset(sizeof(MeshFileHeader));
+	for (int i = 0; i < 5; i++) {
+		*offsets[i] = 0;
+		if (!stream_data[i])
+			continue;
+		*offsets[i] = offset;
+		offset = align_offset(offset + stream_bytes[i]);
+	}
+
+	ofstream ofs(fname, ios::binary);
+	if (ofs.fail()) {
+		cerr << "ERROR: cannot open file for writing: " << fname << endl;
+		return false;
+	}
+
+	ofs.write((const char*)&h, sizeof(h));
+
+	// Pads with zeros up to the next stream offset
+	char padding[mesh_file_alignment] = {};
+	for (int i = 0; i < 5; i++) {
+		if (!stream_data[i])
+			continue;
+		uint64_t pos = (uint64_t)ofs.tellp();
+		ofs.write(padding, (streamsize)(*offsets[i] - pos));
+		ofs.write((const char*)stream_data[i], (streamsize)stream_bytes[i]);
+	}
+
+	if (ofs.fail()) {
+		cerr << "ERROR: failed writing mesh file " << fname << endl;
+		return false;
+	}
+	return true;
+}
+
+static void init_header(MeshFileHeader& h, int num_verts, int num_tris) {
+	h = {};
+	h.magic = mesh_file_magic;
+	h.version = mesh_file_version;
+	h.header_size = sizeof(MeshFileHeader);
+	h.num_verts = (uint32_t)num_verts;
+	h.num_tris = (uint32_t)num_tris;
+}
+
+bool MeshFile::write(char* fname, V3* verts, V3* colors, V3* normals, V3* tcs, int num_verts,
+	unsigned int* tris, int num_tris, bool allow_16bit_indices) {
+	if (!verts || num_verts <= 0 || !tris || num_tris <= 0) {
+		cerr << "ERROR: cannot write empty mesh to " << fname << endl;
+		return false;
+	}
+
+	MeshFileHeader h;
+	init_header(h, num_verts, num_tris);
+
+	for (int i = 0; i < 3; i++) {
+		h.bounds_min[i] = FLT_MAX;
+		h.bounds_max[i] = -FLT_MAX;
+	}
+	for (int vi = 0; vi < num_verts; vi++) {
+		for (int i = 0; i < 3; i++) {
+			h.bounds_min[i] = fminf(h.bounds_min[i], verts[vi][i]);
+			h.bounds_max[i] = fmaxf(h.bounds_max[i], verts[vi][i]);
+		}
+	}
+
+	bool indices_16 = allow_16bit_indices && num_verts <= 65536;
+	if (indices_16)
+		h.flags |= MESH_FILE_INDICES_16;
+	if (colors)
+		h.flags |= MESH_FILE_COLORS;
+	if (normals)
+		h.flags |= MESH_FILE_NORMALS;
+	if (tcs)
+		h.flags |= MESH_FILE_TCS;
+
+	uint64_t attribute_bytes = (uint64_t)num_verts * sizeof(V3);
+	uint64_t index_bytes = (uint64_t)num_tris * 3 * (indices_16 ? sizeof(unsigned short) : sizeof(unsigned int));
+
+	vector<unsigned short> tris_16;
+	if (indices_16)
+		tris_16.assign(tris, tris + num_tris * 3);
+
+	const void* stream_data[5] = { verts, colors, normals, tcs, indices_16 ? (void*)tris_16.data() : (void*)tris };
+	uint64_t stream_bytes[5] = { attribute_bytes, attribute_bytes, attribute_bytes, attribute_bytes, index_bytes };
+	return write_streams(fname, h, stream_data, stream_bytes);
+}
+
+bool MeshFile::write_quantized(char* fname, QuantizedMesh* mesh, V3* tcs) {
+	if (!mesh->positions || mesh->num_verts <= 0 || !mesh->tris || mesh->num_tris <= 0) {
+		cerr << "ERROR: cannot write empty mesh to " << fname << endl;
+		return false;
+	}
+
+	MeshFileHeader h;
+	init_header(h, mesh->num_verts, mesh->num_tris);
+	for (int i = 0; i < 3; i++) {
+		h.bounds_min[i] = mesh->bounds_min[i];
+		h.bounds_max[i] = mesh->bounds_max[i];
+	}
+
+	h.flags |= MESH_FILE_QUANTIZED;
+	if (mesh->indices_16)
+		h.flags |= MESH_FILE_INDICES_16;
+	if (mesh->colors)
+		h.flags |= MESH_FILE_COLORS;
+	if (mesh->normals)
+		h.flags |= MESH_FILE_NORMALS;
+	if (tcs)
+		h.flags |= MESH_FILE_TCS;
+
+	uint64_t n = (uint64_t)mesh->num_verts;
+	const void* stream_data[5] = { mesh->positions, mesh->colors, mesh->normals, tcs, mesh->tris };
+	uint64_t stream_bytes[5] = { n * 3 * sizeof(unsigned short), n * 4, n * 2 * sizeof(short), n * sizeof(V3),
+		(uint64_t)mesh->num_tris * 3 * (mesh->indices_16 ? sizeof(unsigned short) : sizeof(unsigned int)) };
+	return write_streams(fname, h, stream_data, stream_bytes);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+
+#include "v3.h"
+#include "mapped_file.h"
+#include "quantized_mesh.h"
+
+// Binary mesh container, .gpm files. A fixed header followed by attribute streams, each
+// starting at a multiple of mesh_file_alignment so that once the file is mapped the
+// streams can be used in place. Everything is stored in native (little endian) order.
+
+const uint32_t mesh_file_magic = 0x4D504723; // "#GPM"
+const uint32_t mesh_file_version = 2; // 2 added MESH_FILE_QUANTIZED
+const uint32_t mesh_file_alignment = 64;
+
+enum mesh_file_flags : uint32_t {
+	MESH_FILE_COLORS = 1 << 0,
+	MESH_FILE_NORMALS = 1 << 1,
+	MESH_FILE_TCS = 1 << 2,
+	MESH_FILE_INDICES_16 = 1 << 3, // tris stream holds unsigned shorts instead of unsigned ints
+	MESH_FILE_QUANTIZED = 1 << 4, // verts, colors and normals use the QuantizedMesh encoding, bounds give the position range
+};
+
+struct MeshFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t header_size; // sizeof(MeshFileHeader) of the writer
+	uint32_t flags;
+	uint32_t num_verts;
+	uint32_t num_tris;
+	float bounds_min[3];
+	float bounds_max[3];
+
+	// Byte offsets from the start of the file, 0 when the stream is absent.
+	// verts, colors, normals and tcs hold one V3 per vertex, tris three indices per triangle.
+	// In quantized files only tcs stays V3.
+	uint64_t verts_offset;
+	uint64_t colors_offset;
+	uint64_t normals_offset;
+	uint64_t tcs_offset;
+	uint64_t tris_offset;
+};
+
+class MeshFile {
+public:
+	MappedFile file;
+	MeshFileHeader* header; // null until open succeeds
+
+	MeshFile();
+
+	// Maps fname copy-on-write, so meshes can be edited in place without touching the file
+	bool open(char* fname);
+
+	// Streams inside the mapping, null when absent. verts, colors and normals are also null in
+	// quantized files, use get_quantized for those.
+	V3* get_verts();
+	V3* get_colors();
+	V3* get_normals();
+	V3* get_tcs();
+	void* get_tris(); // unsigned short* when has_16bit_indices(), unsigned int* otherwise
+	bool has_16bit_indices();
+	bool is_quantized();
+	bool get_quantized(QuantizedMesh* mesh); // points mesh at the mapped streams, false when not quantized
+
+	// colors, normals and tcs may be null. 16 bit indices are written when allowed and every index fits.
+	static bool write(char* fname, V3* verts, V3* colors, V3* normals, V3* tcs, int num_verts,
+		unsigned int* tris, int num_tris, bool allow_16bit_indices = true);
+	static bool write_quantized(char* fname, QuantizedMesh* mesh, V3* tcs);
+
+private:
+	void* get_stream(uint64_t offset);
+	bool check_stream(char* fname, const char* name, uint64_t offset, uint64_t bytes);
+};
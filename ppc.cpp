@@ -2,18 +2,21 @@
 #include <cmath>
 
 #include "ppc.h"
-#include "framebuffer.h"
+#include "image.h"
 
+#include <cfloat>
 #include <fstream>
 
 PPC::PPC() {
 	w = 0;
 	h = 0;
+	orthographic = false;
 }
 
 PPC::PPC(float hfov, int _w, int _h) {
 	w = _w;
 	h = _h;
+	orthographic = false;
 	C = V3(0.0f, 0.0f, 0.0f);
 	a = V3(1.0f, 0.0f, 0.0f);
 	b = V3(0.0f, -1.0f, 0.0f);
@@ -48,9 +51,15 @@ int PPC::project(V3 P, V3& PP) {
 		return 0;
 	}
 
-	PP[0] = q[0] / q[2];
-	PP[1] = q[1] / q[2];
-	PP[2] = 1.0f / q[2];
+	if (orthographic) {
+		PP[0] = q[0];
+		PP[1] = q[1];
+	}
+	else {
+		PP[0] = q[0] / q[2];
+		PP[1] = q[1] / q[2];
+	}
+	PP[2] = 1.0f / q[2]; //Larger is closer for both projections, matches the z-buffer convention
 
 	return ret;
 }
@@ -156,6 +165,21 @@ void PPC::pose(V3 new_C, V3 look_at_point, V3 up_dir) {
 	m_inverted = m.inverted();
 }
 
+void PPC::set_orthographic(V3 corner, V3 _a, V3 _b, V3 view_dir, int _w, int _h) {
+	orthographic = true;
+	w = _w;
+	h = _h;
+	C = corner;
+	a = _a;
+	b = _b;
+	c = view_dir.normalized();
+
+	m.set_column(0, a);
+	m.set_column(1, b);
+	m.set_column(2, c);
+	m_inverted = m.inverted();
+}
+
 PPC PPC::interpolate(PPC* ppc2, float t) {
 	if (t == 0) return *this;
 	if (t == 1) return *ppc2;
@@ -167,6 +191,7 @@ PPC PPC::interpolate(PPC* ppc2, float t) {
 	ppc_i.c = c + t * (ppc2->c - c);
 	ppc_i.w = w;
 	ppc_i.h = h;
+	ppc_i.orthographic = orthographic;
 	ppc_i.m.set_column(0, ppc_i.a);
 	ppc_i.m.set_column(1, ppc_i.b);
 	ppc_i.m.set_column(2, ppc_i.c);
@@ -176,7 +201,7 @@ PPC PPC::interpolate(PPC* ppc2, float t) {
 }
 
 
-void PPC::visualize(FrameBuffer* fb, PPC* ppc, float focal_length) {
+void PPC::visualize(Image* fb, PPC* ppc, float focal_length) {
 	float f = fabs(get_vd() * c);
 	float scale_factor = focal_length / f;
 
@@ -4,13 +4,14 @@
 #include "m33.h"
 #include <vector>
 
-class FrameBuffer;
+class Image;
 
 class PPC {
 public:
 	V3 a, b, c, C;
 	M33 m, m_inverted; //Save matrix and inversion to save compute time, updated every time a, b, c are updated
 	int w, h;
+	bool orthographic; //Parallel projection: c is the unit view direction and C the corner of the image
 	PPC();
 	PPC(float hfov, int _w, int _h);
 	int project(V3 P, V3& PP);
@@ -34,13 +35,16 @@ public:
 
 	void pose(V3 new_C, V3 look_at_point, V3 up_dir);
 
+	//Orthographic camera looking along view_dir with pixel vectors a and b, C is the top left corner
+	void set_orthographic(V3 corner, V3 _a, V3 _b, V3 view_dir, int _w, int _h);
+
 	PPC interpolate(PPC* ppc2, float t); //t in [0,1]
 
 	friend int load_from_file(PPC** ppcs, char* fname);
 	friend void save_to_file(char* fname);
 	void save_to_file_vector();
 
-	void visualize(FrameBuffer* fb, PPC* ppc, float focal_length);
+	void visualize(Image* fb, PPC* ppc, float focal_length);
 };
 
 extern std::vector<PPC> ppcs_to_save;
@@ -0,0 +1,73 @@
+#include "profiler.h"
+#include "image.h"
+
+using namespace std;
+
+const char* get_stage_name(profile_stage stage) {
+	const char* names[] = { "frame", "shadows", "lighting", "projection", "triangle_setup", "rasterization", "environment" };
+	return names[(int)stage];
+}
+
+const char* get_counter_name(profile_counter counter) {
+	const char* names[] = { "triangles_submitted", "triangles_culled", "triangles_rasterized",
+		"pixels_tested", "pixels_passed", "pixels_shaded" };
+	return names[(int)counter];
+}
+
+float FrameProfile::get_overdraw() const {
+	if (pixels_covered <= 0)
+		return 0.0f;
+	return (float)get(profile_counter::PIXELS_PASSED) / (float)pixels_covered;
+}
+
+Profiler::Profiler() {
+	for (auto& ns : stage_ns) {
+		ns = 0;
+	}
+	for (auto& count : counters) {
+		count = 0;
+	}
+}
+
+void Profiler::add_time(profile_stage stage, long long ns) {
+	stage_ns[(int)stage] += ns;
+}
+
+void Profiler::add(profile_counter counter, long long n) {
+	if (n != 0)
+		counters[(int)counter] += n;
+}
+
+void Profiler::end_frame(Image* image) {
+#if GP_PROFILE
+	FrameProfile frame;
+	for (int i = 0; i < (int)profile_stage::COUNT; i++) {
+		frame.stage_ms[i] = (double)stage_ns[i].exchange(0) / 1e6;
+	}
+	for (int i = 0; i < (int)profile_counter::COUNT; i++) {
+		frame.counters[i] = counters[i].exchange(0);
+	}
+
+	// The z-buffer is cleared to 0 (1/z), anything else was drawn
+	if (image && image->zb) {
+		for (int i = 0; i < image->w * image->h; i++) {
+			frame.pixels_covered += image->zb[i] != 0.0f;
+		}
+	}
+
+	lock_guard<mutex> lock(mtx);
+	last_frame = frame;
+#else
+	(void)image;
+#endif
+}
+
+FrameProfile Profiler::get_last_frame() {
+	lock_guard<mutex> lock(mtx);
+	return last_frame;
+}
+
+Profiler* profiler() {
+	static Profiler instance;
+	return &instance;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+class Image;
+
+// Stage timings and pipeline counters of the software renderer. The instrumentation is
+// compiled in for debug builds and compiled out (empty inline calls) when NDEBUG is defined;
+// define GP_PROFILE as 1 or 0 to override either way.
+#ifndef GP_PROFILE
+#ifdef NDEBUG
+#define GP_PROFILE 0
+#else
+#define GP_PROFILE 1
+#endif
+#endif
+
+enum class profile_stage {
+	FRAME, // all of Renderer::render
+	SHADOWS,
+	LIGHTING, // per-vertex lighting
+	PROJECTION,
+	TRIANGLE_SETUP, // edge equations and bounding boxes
+	RASTERIZATION, // pixel loops, including per-pixel shading
+	ENVIRONMENT,
+	COUNT
+};
+
+enum class profile_counter {
+	TRIANGLES_SUBMITTED,
+	TRIANGLES_CULLED, // behind the camera, zero area or off screen
+	TRIANGLES_RASTERIZED,
+	PIXELS_TESTED, // inside a triangle, reached the depth test
+	PIXELS_PASSED, // passed the depth test
+	PIXELS_SHADED, // had a color computed, environment pixels included
+	COUNT
+};
+
+const char* get_stage_name(profile_stage stage);
+const char* get_counter_name(profile_counter counter);
+
+struct FrameProfile {
+	double stage_ms[(int)profile_stage::COUNT] = {};
+	long long counters[(int)profile_counter::COUNT] = {};
+	long long pixels_covered = 0; // pixels with geometry when the frame ended
+
+	double get_ms(profile_stage stage) const { return stage_ms[(int)stage]; }
+	long long get(profile_counter counter) const { return counters[(int)counter]; }
+	float get_overdraw() const; // depth test passes per covered pixel, 1 means no pixel was drawn twice
+};
+
+class Profiler {
+public:
+	Profiler();
+
+	void add_time(profile_stage stage, long long ns);
+	void add(profile_counter counter, long long n);
+
+	// Everything recorded since the previous call becomes the profile of the frame that just
+	// ended, image is the frame's target and used for pixels_covered. Concurrently rendered
+	// frames (Renderer::render_path) share one set of totals.
+	void end_frame(Image* image);
+	FrameProfile get_last_frame();
+
+private:
+	std::atomic<long long> stage_ns[(int)profile_stage::COUNT];
+	std::atomic<long long> counters[(int)profile_counter::COUNT];
+	std::mutex mtx;
+	FrameProfile last_frame;
+};
+
+Profiler* profiler();
+
+#if GP_PROFILE
+
+// Adds the time from construction to stop() or destruction to stage
+class ProfileScope {
+public:
+	ProfileScope(profile_stage _stage) : stage(_stage), start(std::chrono::steady_clock::now()), running(true) {}
+	~ProfileScope() { stop(); }
+
+	void stop() {
+		if (!running)
+			return;
+		running = false;
+		profiler()->add_time(stage, std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start).count());
+	}
+
+private:
+	profile_stage stage;
+	std::chrono::steady_clock::time_point start;
+	bool running;
+};
+
+// Counts pixels in locals and adds them to the profiler once, when it goes out of scope
+class PixelCounter {
+public:
+	~PixelCounter() {
+		profiler()->add(profile_counter::PIXELS_TESTED, num_tested);
+		profiler()->add(profile_counter::PIXELS_PASSED, num_passed);
+		profiler()->add(profile_counter::PIXELS_SHADED, num_shaded);
+	}
+
+	void tested() { num_tested++; }
+	void passed() { num_passed++; }
+	void shaded(int n = 1) { num_shaded += n; }
+
+private:
+	long long num_tested = 0, num_passed = 0, num_shaded = 0;
+};
+
+inline void profile_count(profile_counter counter, long long n) { profiler()->add(counter, n); }
+
+#else
+
+class ProfileScope {
+public:
+	ProfileScope(profile_stage) {}
+	void stop() {}
+};
+
+class PixelCounter {
+public:
+	void tested() {}
+	void passed() {}
+	void shaded(int = 1) {}
+};
+
+inline void profile_count(profile_counter, long long) {}
+
+#endif
@@ -0,0 +1,224 @@
+#include "quantized_mesh.h"
+#include "ppc.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace std;
+
+QuantizedMesh::QuantizedMesh() {
+	num_verts = 0;
+	num_tris = 0;
+	positions = nullptr;
+	normals = nullptr;
+	colors = nullptr;
+	tris = nullptr;
+	indices_16 = false;
+	owns_streams = false;
+}
+
+QuantizedMesh::~QuantizedMesh() {
+	release();
+}
+
+void QuantizedMesh::release() {
+	if (owns_streams) {
+		delete[] positions;
+		delete[] normals;
+		delete[] colors;
+		if (indices_16)
+			delete[] (unsigned short*)tris;
+		else
+			delete[] (unsigned int*)tris;
+	}
+	positions = nullptr;
+	normals = nullptr;
+	colors = nullptr;
+	tris = nullptr;
+	owns_streams = false;
+}
+
+void QuantizedMesh::set_bounds(V3 _bounds_min, V3 _bounds_max) {
+	bounds_min = _bounds_min;
+	bounds_max = _bounds_max;
+	for (int i = 0; i < 3; i++) {
+		position_scale[i] = (bounds_max[i] - bounds_min[i]) / 65535.0f;
+	}
+}
+
+QuantizedMesh* QuantizedMesh::share() {
+	QuantizedMesh* mesh = new QuantizedMesh();
+	mesh->num_verts = num_verts;
+	mesh->num_tris = num_tris;
+	mesh->set_bounds(bounds_min, bounds_max);
+	mesh->positions = positions;
+	mesh->normals = normals;
+	mesh->colors = colors;
+	mesh->tris = tris;
+	mesh->indices_16 = indices_16;
+	mesh->owns_streams = false;
+	return mesh;
+}
+
+static unsigned short quantize_unit(float t, float levels) {
+	t = fminf(fmaxf(t, 0.0f), 1.0f);
+	return (unsigned short)(t * levels + 0.5f);
+}
+
+void octahedral_encode(V3 n, short& ex, short& ey) {
+	float l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+	if (l1 == 0.0f) {
+		ex = 0;
+		ey = 0;
+		return;
+	}
+	float x = n[0] / l1;
+	float y = n[1] / l1;
+
+	// The lower hemisphere folds over the diagonals of the square
+	if (n[2] < 0.0f) {
+		float fx = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float fy = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = fx;
+		y = fy;
+	}
+
+	ex = (short)roundf(fminf(fmaxf(x, -1.0f), 1.0f) * 32767.0f);
+	ey = (short)roundf(fminf(fmaxf(y, -1.0f), 1.0f) * 32767.0f);
+}
+
+V3 octahedral_decode(short ex, short ey) {
+	float x = (float)ex * (1.0f / 32767.0f);
+	float y = (float)ey * (1.0f / 32767.0f);
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	if (z < 0.0f) {
+		float fx = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float fy = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = fx;
+		y = fy;
+	}
+	float inv_len = 1.0f / sqrtf(x * x + y * y + z * z);
+	return V3(x * inv_len, y * inv_len, z * inv_len);
+}
+
+V3 QuantizedMesh::decode_normal(int vi) {
+	return octahedral_decode(normals[vi * 2 + 0], normals[vi * 2 + 1]);
+}
+
+void QuantizedMesh::encode(V3* verts, V3* _colors, V3* _normals, int _num_verts, unsigned int* _tris, int _num_tris) {
+	release();
+	num_verts = _num_verts;
+	num_tris = _num_tris;
+	owns_streams = true;
+
+	V3 bmin(FLT_MAX, FLT_MAX, FLT_MAX);
+	V3 bmax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (int vi = 0; vi < num_verts; vi++) {
+		for (int i = 0; i < 3; i++) {
+			bmin[i] = fminf(bmin[i], verts[vi][i]);
+			bmax[i] = fmaxf(bmax[i], verts[vi][i]);
+		}
+	}
+	set_bounds(bmin, bmax);
+
+	positions = new unsigned short[num_verts * 3];
+	for (int vi = 0; vi < num_verts; vi++) {
+		for (int i = 0; i < 3; i++) {
+			float extent = bounds_max[i] - bounds_min[i];
+			float t = (extent > 0.0f) ? (verts[vi][i] - bounds_min[i]) / extent : 0.0f;
+			positions[vi * 3 + i] = quantize_unit(t, 65535.0f);
+		}
+	}
+
+	if (_normals) {
+		normals = new short[num_verts * 2];
+		for (int vi = 0; vi < num_verts; vi++) {
+			octahedral_encode(_normals[vi], normals[vi * 2 + 0], normals[vi * 2 + 1]);
+		}
+	}
+
+	if (_colors) {
+		colors = new unsigned char[num_verts * 4];
+		for (int vi = 0; vi < num_verts; vi++) {
+			for (int i = 0; i < 3; i++) {
+				colors[vi * 4 + i] = (unsigned char)quantize_unit(_colors[vi][i], 255.0f);
+			}
+			colors[vi * 4 + 3] = 255;
+		}
+	}
+
+	indices_16 = num_verts <= 65536;
+	if (indices_16) {
+		unsigned short* tris_16 = new unsigned short[num_tris * 3];
+		for (int i = 0; i < num_tris * 3; i++) {
+			tris_16[i] = (unsigned short)_tris[i];
+		}
+		tris = tris_16;
+	}
+	else {
+		unsigned int* tris_32 = new unsigned int[num_tris * 3];
+		copy(_tris, _tris + num_tris * 3, tris_32);
+		tris = tris_32;
+	}
+}
+
+void QuantizedMesh::project(PPC* ppc, V3* projected) {
+	// q = m_inverted * (bounds_min + scale * p - C) = offset + m_scaled * p
+	M33 m_scaled;
+	for (int i = 0; i < 3; i++) {
+		m_scaled.set_column(i, ppc->m_inverted.get_column(i) * position_scale[i]);
+	}
+	V3 offset = ppc->m_inverted * (bounds_min - ppc->C);
+	V3 r0 = m_scaled[0], r1 = m_scaled[1], r2 = m_scaled[2];
+
+	for (int vi = 0; vi < num_verts; vi++) {
+		unsigned short* p = positions + vi * 3;
+		float px = (float)p[0], py = (float)p[1], pz = (float)p[2];
+
+		float qz = offset[2] + r2[0] * px + r2[1] * py + r2[2] * pz;
+		if (qz <= 0.0f) {
+			projected[vi] = V3(FLT_MAX, 0.0f, 0.0f); // behind the camera, as in PPC::project
+			continue;
+		}
+		float qx = offset[0] + r0[0] * px + r0[1] * py + r0[2] * pz;
+		float qy = offset[1] + r1[0] * px + r1[1] * py + r1[2] * pz;
+
+		float inv_qz = 1.0f / qz;
+		if (ppc->orthographic)
+			projected[vi] = V3(qx, qy, inv_qz);
+		else
+			projected[vi] = V3(qx * inv_qz, qy * inv_qz, inv_qz);
+	}
+}
+
+void QuantizedMesh::decode(V3* verts, V3* _colors, V3* _normals, unsigned int* _tris) {
+	for (int vi = 0; vi < num_verts; vi++) {
+		verts[vi] = decode_position(vi);
+		if (_colors && colors)
+			_colors[vi] = decode_color(vi);
+		if (_normals && normals)
+			_normals[vi] = decode_normal(vi);
+	}
+	if (!_tris)
+		return;
+	for (int i = 0; i < num_tris * 3; i++) {
+		_tris[i] = get_index(i);
+	}
+}
+
+void QuantizedMesh::scale_and_translate(float s, V3 t) {
+	bounds_min = bounds_min * s + t;
+	bounds_max = bounds_max * s + t;
+	position_scale = position_scale * s;
+}
+
+int QuantizedMesh::get_size_in_bytes() {
+	int bytes = num_verts * 3 * (int)sizeof(unsigned short);
+	if (normals)
+		bytes += num_verts * 2 * (int)sizeof(short);
+	if (colors)
+		bytes += num_verts * 4;
+	bytes += num_tris * 3 * (indices_16 ? (int)sizeof(unsigned short) : (int)sizeof(unsigned int));
+	return bytes;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "v3.h"
+
+class PPC;
+
+// Compact vertex and index encoding, about a third of the float layout:
+// positions are 16 bit per axis across the bounds, normals are octahedral
+// 16 bit pairs, colors are 8 bit per channel and indices are 16 bit when every
+// index fits. Decoding is cheap enough to do on the fly while projecting.
+class QuantizedMesh {
+public:
+	int num_verts;
+	int num_tris;
+	V3 bounds_min, bounds_max;
+	V3 position_scale; // (bounds_max - bounds_min) / 65535
+
+	unsigned short* positions; // 3 per vertex
+	short* normals; // 2 per vertex, null when absent
+	unsigned char* colors; // 4 per vertex (RGB and one unused byte), null when absent
+	void* tris; // unsigned short* when indices_16, unsigned int* otherwise
+	bool indices_16;
+
+	bool owns_streams; // false when the streams point into a mapped mesh file
+
+	QuantizedMesh();
+	~QuantizedMesh();
+
+	// colors and normals may be null
+	void encode(V3* verts, V3* colors, V3* normals, int num_verts, unsigned int* tris, int num_tris);
+	void set_bounds(V3 _bounds_min, V3 _bounds_max);
+	QuantizedMesh* share(); // new mesh using these streams in place, they have to outlive it
+
+	V3 decode_position(int vi) {
+		unsigned short* q = positions + vi * 3;
+		return V3(bounds_min[0] + position_scale[0] * (float)q[0],
+			bounds_min[1] + position_scale[1] * (float)q[1],
+			bounds_min[2] + position_scale[2] * (float)q[2]);
+	}
+
+	V3 decode_normal(int vi);
+
+	V3 decode_color(int vi) {
+		unsigned char* c = colors + vi * 4;
+		const float s = 1.0f / 255.0f;
+		return V3((float)c[0] * s, (float)c[1] * s, (float)c[2] * s);
+	}
+
+	unsigned int get_index(int i) {
+		return indices_16 ? ((unsigned short*)tris)[i] : ((unsigned int*)tris)[i];
+	}
+
+	// Same results as ppc->project(decode_position(vi), projected[vi]) for every vertex,
+	// with the dequantization folded into the camera matrix
+	void project(PPC* ppc, V3* projected);
+
+	// p' = s * p + t for every position, s > 0, exact since it only moves the bounds; normals are unchanged
+	void scale_and_translate(float s, V3 t);
+
+	// Expands to float arrays of num_verts (num_tris * 3 for tris), colors, normals and tris are skipped when null
+	void decode(V3* verts, V3* colors, V3* normals, unsigned int* tris);
+
+	int get_size_in_bytes();
+
+private:
+	void release();
+
+	QuantizedMesh(const QuantizedMesh&) = delete;
+	QuantizedMesh& operator=(const QuantizedMesh&) = delete;
+};
+
+void octahedral_encode(V3 n, short& ex, short& ey);
+V3 octahedral_decode(short ex, short ey);
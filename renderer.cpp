@@ -0,0 +1,345 @@
+#include "renderer.h"
+#include "lighting.h"
+#include "profiler.h"
+#include "trace.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <condition_variable>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+Renderer::Renderer(Image* _image, PPC* _ppc) {
+	image = _image;
+	ppc = _ppc;
+	num_tms = 0;
+	tms = nullptr;
+	shadow_map = new ShadowMap(512, 512, V3());
+	sun_shadow_map = nullptr;
+	cube_map = nullptr;
+	terrain = nullptr;
+	asset_loader = new AssetLoader();
+	render_light = true;
+	ambient_factor = .4f;
+	specular_exp = 200;
+
+	add_light(V3(), FLT_MAX, true);
+	lights[0]->shadow_map = shadow_map;
+	light_grid = new LightGrid();
+}
+
+void Renderer::add_light(V3 pos, float radius, bool casts_shadows) {
+	lights.push_back(new PointLight(pos, radius, casts_shadows));
+}
+
+void Renderer::render_shadows() {
+	TraceScope trace("Renderer::render_shadows");
+	ProfileScope shadows(profile_stage::SHADOWS);
+	unsigned int geometry_version = 0;
+	for (int i = 0; i < num_tms; i++) {
+		geometry_version = max(geometry_version, tms[i].geometry_version);
+	}
+
+	for (PointLight* light : lights) {
+		// Lighting takes the primary light's position from its map, keep it current without shadows too
+		if (light->shadow_map)
+			light->shadow_map->set_pos(light->pos);
+		if (!light->casts_shadows)
+			continue;
+
+		if (!light->shadow_map)
+			light->shadow_map = new ShadowMap(512, 512, light->pos);
+		light->shadow_map->set_pos(light->pos);
+
+		// Shadows only depend on the light position and the meshes, skip when neither changed
+		if (light->shadow_map->version == light->shadows_map_version &&
+			geometry_version == light->shadows_geometry_version)
+			continue;
+
+		light->shadow_map->clear();
+		for (int i = 0; i < num_tms; i++) {
+			light->shadow_map->add_tm(&tms[i]);
+		}
+
+		light->shadows_map_version = light->shadow_map->version;
+		light->shadows_geometry_version = geometry_version;
+	}
+}
+
+void Renderer::render_sun_shadows() {
+	if (!sun_shadow_map || num_tms < 1)
+		return;
+	TraceScope trace("Renderer::render_sun_shadows");
+	ProfileScope shadows(profile_stage::SHADOWS);
+
+	V3 scene_min(FLT_MAX, FLT_MAX, FLT_MAX);
+	V3 scene_max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (int i = 0; i < num_tms; i++) {
+		V3 p1, p2;
+		tms[i].get_bounding_box(p1, p2);
+		for (int j = 0; j < 3; j++) {
+			scene_min[j] = min(scene_min[j], p1[j]);
+			scene_max[j] = max(scene_max[j], p2[j]);
+		}
+	}
+
+	// Cascades only need to cover the view depths the scene actually occupies
+	V3 vd = ppc->get_vd();
+	float far_d = 0.0f;
+	for (int i = 0; i < 8; i++) {
+		V3 corner((i & 1) ? scene_max[0] : scene_min[0],
+			(i & 2) ? scene_max[1] : scene_min[1],
+			(i & 4) ? scene_max[2] : scene_min[2]);
+		far_d = max(far_d, (corner - ppc->C) * vd);
+	}
+	if (far_d <= 1.0f)
+		return;
+
+	sun_shadow_map->fit_cascades(ppc, 1.0f, far_d, scene_min, scene_max);
+	sun_shadow_map->clear();
+	for (int i = 0; i < num_tms; i++) {
+		sun_shadow_map->add_tm(&tms[i]);
+	}
+}
+
+void Renderer::render(render_type rt) {
+	TraceScope trace("Renderer::render");
+	ProfileScope frame(profile_stage::FRAME);
+	if (rt == render_type::LIGHTED && per_pixel_lighting)
+		rt = render_type::PIXEL_LIGHTED;
+	// PixelLighting only has point lights, under a sun the frame is lit per vertex instead
+	if (rt == render_type::PIXEL_LIGHTED && sun_shadow_map) {
+		static bool warned = false;
+		if (!warned)
+			cerr << "INFO: per-pixel lighting has no directional lights, lighting per vertex under the sun" << endl;
+		warned = true;
+		rt = render_type::LIGHTED;
+	}
+	bool lighted = rt == render_type::LIGHTED || rt == render_type::PIXEL_LIGHTED;
+
+	asset_loader->poll();
+
+	image->set_heatmap(show_heatmap);
+	image->clear();
+
+	if (render_light && lighted && lights.size() > 1)
+		light_grid->build(lights, ppc);
+
+	for (int i = 0; i < num_tms; i++) {
+		render(tms[i], rt);
+	}
+
+	if (terrain) {
+		terrain->update(ppc);
+		vector<TM*> chunk_tms;
+		terrain->get_resident(chunk_tms);
+		for (TM* tm : chunk_tms) {
+			render(*tm, rt);
+		}
+	}
+
+	if (render_light && lighted && show_lights) {
+		for (PointLight* light : lights) {
+			image->visualize_point_light(light->pos, ppc);
+		}
+	}
+
+	if (cube_map)
+		cube_map->render_as_environment(ppc, image);
+
+	if (show_heatmap)
+		image->heatmap->draw(image, heatmap_type);
+
+	frame.stop();
+	profiler()->end_frame(image);
+}
+
+void Renderer::render(TM& tm, render_type rt) {
+	bool shadows = lights[0]->casts_shadows;
+	bool textured = tm.tex && tm.tcs;
+	if (!textured && render_light && rt == render_type::PIXEL_LIGHTED) {
+		PixelLighting pixel_lighting;
+		pixel_lighting.light_pos = shadow_map->pos;
+		pixel_lighting.eye_pos = ppc->C;
+		pixel_lighting.ka = ambient_factor;
+		pixel_lighting.table = specular_table(specular_exp);
+		pixel_lighting.shadow_map = shadows ? shadow_map : nullptr;
+		pixel_lighting.lights = lights.data();
+		pixel_lighting.grid = (lights.size() > 1) ? light_grid : nullptr;
+		tm.rasterize(ppc, image, cube_map, rt, &pixel_lighting);
+		return;
+	}
+	if (!textured && render_light && rt == render_type::LIGHTED) {
+		if (sun_shadow_map)
+			tm.light_directional(sun_shadow_map, ppc->C, ambient_factor, specular_exp);
+		else if (lights.size() > 1)
+			tm.light_points(lights, light_grid, ppc, ambient_factor, specular_exp);
+		else
+			tm.light_point(shadow_map, ppc->C, ambient_factor, specular_exp, shadows);
+	}
+	if (textured)
+		tm.rasterize(ppc, image, cube_map, render_type::NORMAL_TILING_TEXTURED);
+	else
+		tm.rasterize(ppc, image, cube_map, rt);
+}
+
+
+// Sun cascades are refitted to every camera and terrain chunks stream in around it, both
+// change shared state while a frame renders
+bool Renderer::can_render_concurrently() {
+	return !sun_shadow_map && !terrain;
+}
+
+int Renderer::render_path(PPC* ppcs, int num_ppcs, int num_frames, render_type rt,
+	const function<void(int frame, Image* image)>& output) {
+	if (num_ppcs < 2 || num_frames < 1)
+		return 0;
+
+	int frames_per_camera = max(1, num_frames / (num_ppcs - 1));
+	int total_frames = frames_per_camera * (num_ppcs - 1);
+	auto get_frame_ppc = [=](int frame) {
+		int p = frame / frames_per_camera;
+		float t = (float)(frame % frames_per_camera) / (float)frames_per_camera;
+		return ppcs[p].interpolate(&ppcs[p + 1], t);
+	};
+
+	// Everything the frames read has to be in place before the first one starts
+	asset_loader->wait_all();
+	bool lighted = rt == render_type::LIGHTED || rt == render_type::PIXEL_LIGHTED;
+	if (render_light && lighted)
+		render_shadows();
+
+	int num_slots = thread_pool()->num_workers() + 1;
+	if (num_slots == 1 || !can_render_concurrently()) {
+		Image* scene_image = image;
+		PPC* scene_ppc = ppc;
+		Image frame_image(ppcs[0].w, ppcs[0].h);
+		image = &frame_image;
+		for (int frame = 0; frame < total_frames; frame++) {
+			PPC frame_ppc = get_frame_ppc(frame);
+			ppc = &frame_ppc;
+			if (render_light && lighted)
+				render_sun_shadows();
+			render(rt);
+			output(frame, &frame_image);
+		}
+		image = scene_image;
+		ppc = scene_ppc;
+		return total_frames;
+	}
+
+	// Mirrors of quantized meshes without normals expand them on first use, do it once here
+	// rather than on the shared meshes from every thread
+	for (int i = 0; i < num_tms; i++) {
+		TM& tm = tms[i];
+		if (tm.quantized && !tm.verts && rt == render_type::MIRROR_ONLY && !tm.quantized->normals)
+			tm.dequantize();
+	}
+
+	// Two images per thread so finished frames can wait for an earlier one without stalling
+	vector<Image*> images;
+	for (int i = 0; i < 2 * num_slots; i++) {
+		images.push_back(new Image(ppcs[0].w, ppcs[0].h));
+	}
+
+	mutex mtx;
+	condition_variable cv;
+	vector<Image*> free_images = images;
+	map<int, Image*> ready; // rendered frames waiting for an earlier one
+	int next_frame = 0;
+	int next_output = 0;
+	bool writing = false;
+
+	// Whoever completes the next frame in order writes it and any that were waiting on it
+	auto deliver = [&](int frame, Image* frame_image) {
+		unique_lock<mutex> lock(mtx);
+		ready[frame] = frame_image;
+		if (writing)
+			return;
+		writing = true;
+		while (!ready.empty() && ready.begin()->first == next_output) {
+			Image* out = ready.begin()->second;
+			ready.erase(ready.begin());
+			lock.unlock();
+			{
+				TraceScope trace("render_path output");
+				output(next_output, out);
+			}
+			lock.lock();
+			free_images.push_back(out);
+			next_output++;
+			cv.notify_all();
+		}
+		writing = false;
+	};
+
+	// The slots run on their own threads, each frame's lighting runs parallel_for on the pool
+	// and would wait forever on a pool whose workers are all busy rendering frames
+	auto render_slot = [&]() {
+		// Meshes share their geometry, colors and textures, but projecting and lighting
+		// write per-vertex arrays, so every thread gets its own
+		vector<TM> frame_tms(tms, tms + num_tms);
+		for (TM& tm : frame_tms) {
+			tm.projected_verts = new V3[tm.num_verts];
+			tm.lighted_colors = nullptr;
+			tm.diffuse_terms = nullptr;
+			tm.specular_terms = nullptr;
+			tm.shadowed = nullptr;
+			tm.lighting_cache = LightingCache();
+		}
+
+		Renderer frame_renderer = *this;
+		frame_renderer.tms = frame_tms.data();
+		frame_renderer.light_grid = new LightGrid();
+
+		while (true) {
+			// Taking the image before the frame number keeps the next frame to write always in progress
+			Image* frame_image;
+			int frame;
+			{
+				TraceScope trace("render_path wait for image");
+				unique_lock<mutex> lock(mtx);
+				cv.wait(lock, [&] { return !free_images.empty(); });
+				if (next_frame >= total_frames)
+					break;
+				frame_image = free_images.back();
+				free_images.pop_back();
+				frame = next_frame++;
+			}
+
+			PPC frame_ppc = get_frame_ppc(frame);
+			frame_renderer.image = frame_image;
+			frame_renderer.ppc = &frame_ppc;
+			frame_renderer.render(rt);
+			deliver(frame, frame_image);
+		}
+
+		for (TM& tm : frame_tms) {
+			delete[] tm.projected_verts;
+			delete[] tm.lighted_colors;
+			delete[] tm.diffuse_terms;
+			delete[] tm.specular_terms;
+			delete[] tm.shadowed;
+		}
+		delete frame_renderer.light_grid;
+	};
+
+	vector<thread> slot_threads;
+	for (int i = 1; i < num_slots; i++) {
+		slot_threads.emplace_back(render_slot);
+	}
+	render_slot();
+	for (thread& slot_thread : slot_threads) {
+		slot_thread.join();
+	}
+
+	for (Image* frame_image : images) {
+		delete frame_image;
+	}
+	return total_frames;
+}
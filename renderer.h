@@ -0,0 +1,59 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "image.h"
+#include "heatmap.h"
+#include "ppc.h"
+#include "tm.h"
+#include "light.h"
+#include "cube_map.h"
+#include "streaming_mesh.h"
+#include "asset_loader.h"
+
+// The software pipeline without any window: meshes, lights and environment rendered from
+// ppc into image. Scene adds the GUI on top, the batch renderer uses it directly.
+class Renderer {
+public:
+	Image* image; // render target
+	PPC* ppc;
+	std::vector<PointLight*> lights; // lights[0] is the primary light and uses shadow_map
+	LightGrid* light_grid;
+	int num_tms;
+	TM* tms;
+	ShadowMap* shadow_map;
+	DirectionalShadowMap* sun_shadow_map; // when set, LIGHTED meshes are lit by this directional light instead of the point lights
+	CubeMap* cube_map;
+	StreamingMesh* terrain; // rendered after tms when set, chunks stream in around ppc
+	AssetLoader* asset_loader; // meshes and textures of the scene file, installed at the start of each render
+	std::string camera_path = "cameras.bin"; // camera path of the scene file
+
+	bool render_light;
+	bool per_pixel_lighting = false; // renders LIGHTED as PIXEL_LIGHTED, except under a sun
+	bool show_lights = true; // draws a marker at every point light
+	bool show_heatmap = false; // replaces the frame with the per-pixel count of heatmap_type
+	heatmap_metric heatmap_type = heatmap_metric::DEPTH_WRITES;
+	float ambient_factor;
+	int specular_exp;
+
+	Renderer(Image* _image, PPC* _ppc);
+
+	void render(render_type rt); // clears image and draws the frame
+	void render(TM& tm, render_type rt);
+	void render_shadows();
+	void render_sun_shadows();
+	void add_light(V3 pos, float radius, bool casts_shadows);
+
+	// Renders num_frames frames interpolated along the cameras in ppcs, as many at once as the
+	// thread pool has threads. Each frame goes into its own Image with per-frame copies of the
+	// mesh scratch arrays, the scene itself is only read. output gets the frames in order, from
+	// whichever thread completed the next one, and the image is reused once it returns.
+	// Returns the number of frames rendered.
+	int render_path(PPC* ppcs, int num_ppcs, int num_frames, render_type rt,
+		const std::function<void(int frame, Image* image)>& output);
+
+private:
+	bool can_render_concurrently();
+};
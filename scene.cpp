@@ -1,16 +1,21 @@
 #include "GL/glew.h"
 #include "scene.h"
 #include "m33.h"
+#include "lighting.h"
+#include "scene_file.h"
+#include "image_writer.h"
+#include "video_stream.h"
 
 Scene *scene;
 
+#include <cfloat>
 #include <iostream>
 #include <fstream>
 #include <strstream>
 
 using namespace std;
 
-Scene::Scene() {
+Scene::Scene() : Renderer(nullptr, nullptr) {
 	int u0 = 20;
 	int v0 = 40;
 	int h = 480;
@@ -21,6 +26,8 @@ Scene::Scene() {
 	fb->label("SW Framebuffer");
 	fb->show();
 	fb->redraw();
+	image = fb;
+	last_frame_time = chrono::steady_clock::now();
 
 	hw_fb = new HWFrameBuffer(u0, v0, w, h);
 	hw_fb->position(u0 + w + u0, v0);
@@ -30,30 +37,14 @@ Scene::Scene() {
 	hw_fb->hide();
 
 	ppc = new PPC(60.0f, w, h);
-	render_light = true;
-	ambient_factor = .4f;
-	specular_exp = 200;
-
-	num_tms = 3;
-	tms = new TM[num_tms];
-	tms[0] = TM("geometry/teapot1K.bin");
-	if (num_tms > 1) {
-		tms[1] = TM();
-		tms[1].set_as_quad(V3(-100.0f, 0.0f, -100.0f),
-			V3(-100.0f, 0.0f, 100.0f),
-			V3(100.0f, 0.0f, -100.0f),
-			V3(100.0f, 0.0f, 100.0f),
-			0xFF0000FF);
-	}
-	if (num_tms > 2) {
-		tms[2] = make_texture_tms()[1];
-		tms[2].position(V3(0.0f, 30.0f, 100.0f));
-		tms[2].scale(.75f);
-	}
+	point_light = &lights[0]->pos;
 
-	shadow_map = new ShadowMap(512, 512, V3());
-	cube_map = nullptr;
-	point_light = new V3();
+	// Returns once the file is parsed, meshes and textures keep loading while the first frames render
+	if (!load_scene_file("scenes/default.scene", this, asset_loader)) {
+		num_tms = 1;
+		tms = new TM[num_tms];
+		asset_loader->load_mesh(&tms[0], "geometry/teapot1K.bin");
+	}
 
 	pong_game = nullptr;
 	tetris_game = new Tetris(fb);
@@ -70,28 +61,46 @@ Scene::Scene() {
 
 void Scene::render_cameras_as_frames() {
 	PPC* ppcs;
-	int num_ppcs = load_from_file(&ppcs, "cameras.bin");
+	int num_ppcs = load_from_file(&ppcs, (char*)camera_path.c_str());
 	if (num_ppcs < 1) {
-		cerr << "ERROR: cannot load cameras from file cameras.bin" << endl;
+		cerr << "ERROR: cannot load cameras from file " << camera_path << endl;
 		return;
 	}
 	if (num_ppcs == 1) {
-		cerr << "ERROR: only one camera in cameras.bin, need at least two" << endl;
+		cerr << "ERROR: only one camera in " << camera_path << ", need at least two" << endl;
 		return;
 	}
 
-	TM tm("geometry/teapot1K.bin");
-
 	int num_frames = 1500;
 	int frames_per_camera = num_frames / (num_ppcs - 1);
-	int frame_counter = 0;
 
 	render_type rt = render_type::NOT_LIGHTED;
 	bool save_to_file = false;
-
-	// Create frames directory
-	if (save_to_file)
-		system("mkdir frames");
+	bool save_to_video = false; // one frames.y4m instead of a TIFF per frame
+
+	// Saved frames render concurrently off screen instead of being played back in the window
+	if (save_to_video) {
+		VideoStream stream;
+		if (!stream.open("frames.y4m", video_format::Y4M, ppcs[0].w, ppcs[0].h))
+			return;
+		render_path(ppcs, num_ppcs, num_frames, rt, [&stream](int frame, Image* image) {
+			stream.write(image);
+		});
+		return;
+	}
+	if (save_to_file) {
+		if (!make_directory("frames")) {
+			cerr << "ERROR: cannot create directory frames" << endl;
+			return;
+		}
+		ImageWriter writer(tiff_compression::LZW);
+		render_path(ppcs, num_ppcs, num_frames, rt, [&writer](int frame, Image* image) {
+			char filename[256];
+			sprintf_s(filename, "frames/frame_%03d.tiff", frame);
+			writer.write(filename, image);
+		});
+		return;
+	}
 
 	PPC* scene_ppc = ppc; // Save original ppc
 
@@ -103,47 +112,40 @@ void Scene::render_cameras_as_frames() {
 
 			ppc = &ppc_start.interpolate(&ppc_end, t);
 			render(rt);
-			
-			// Save frame to TIFF file
-			if (save_to_file) {
-				char filename[256];
-				sprintf_s(filename, "frames/frame_%03d.tiff", frame_counter++);
-				fb->save_as_tiff(filename);
-			}
 		}
 	}
 	ppc = scene_ppc; // Restore original ppc
 }
 
-void Scene::render_shadows() {
-	shadow_map->clear();
-	for (int i = 0; i < num_tms; i++) {
-		shadow_map->add_tm(&tms[i]);
-	}
-}
-
-
 void Scene::render(render_type rt) {
-	fb->clear();
-
-	for (int i = 0; i < num_tms; i++) {
-		render(tms[i], rt);
-	}
-
-	if (render_light && rt == render_type::LIGHTED) {
-		fb->visualize_point_light(*point_light, ppc);
-		if (hw_fb) {
-			hw_fb->move_light(*point_light);
+	// Meshes and textures that finished loading since the last frame
+	if (asset_loader->poll() > 0 && hw_fb)
+		hw_fb->tms_changed();
+
+	auto frame_start = chrono::steady_clock::now();
+	Renderer::render(rt);
+
+	if (show_hud) {
+		auto now = chrono::steady_clock::now();
+		hud.add_frame(chrono::duration<double, milli>(now - frame_start).count(),
+			chrono::duration<double, milli>(now - last_frame_time).count());
+		last_frame_time = now;
+
+		long long num_tris = 0;
+		for (int i = 0; i < num_tms; i++) {
+			num_tris += tms[i].num_tris;
 		}
+		hud.draw(image, profiler()->get_last_frame(), num_tris);
 	}
 
-	if (cube_map)
-		cube_map->render_as_environment(ppc, fb);
+	bool lighted = rt == render_type::LIGHTED || rt == render_type::PIXEL_LIGHTED;
+	if (render_light && lighted && hw_fb)
+		hw_fb->move_light(*point_light);
 
 	if (hw_fb) {
 		hw_fb->ppc = ppc;
 		hw_fb->render_wireframe = render_wireframe;
-		if (rt == render_type::LIGHTED)
+		if (lighted)
 			hw_fb->use_lighting = render_light;
 		else
 			hw_fb->use_lighting = false;
@@ -154,21 +156,77 @@ void Scene::render(render_type rt) {
 	Fl::check();
 }
 
-void Scene::render(TM& tm, render_type rt) {
-	if (!tm.tex && render_light && rt == render_type::LIGHTED) {
-		tm.light_point(shadow_map, ppc->C, ambient_factor, specular_exp);
-	}
-	if (tm.tex)
-		tm.rasterize(ppc, fb, cube_map, render_type::NORMAL_TILING_TEXTURED);
-	else
-		tm.rasterize(ppc, fb, cube_map, rt);
-}
-
 void Scene::DBG() {
 	cerr << endl;
 	int choice = 8;
 	
 	switch (choice) {
+	case 11: { //Streamed terrain, made with MeshBaker -chunks 16 geometry/terrain.bin
+		terrain = new StreamingMesh(64 << 20, FLT_MAX);
+		if (!terrain->open("geometry/terrain.gpc")) {
+			cerr << "ERROR: run MeshBaker -chunks 16 geometry/terrain.bin to create geometry/terrain.gpc" << endl;
+			delete terrain;
+			terrain = nullptr;
+			return;
+		}
+		num_tms = 0;
+
+		ChunkedMeshHeader& h = terrain->file.header;
+		V3 bmin(h.bounds_min[0], h.bounds_min[1], h.bounds_min[2]);
+		V3 bmax(h.bounds_max[0], h.bounds_max[1], h.bounds_max[2]);
+		V3 extent = bmax - bmin;
+		terrain->load_distance = 0.25f * fmaxf(extent[0], extent[2]);
+		terrain->memory_budget = 16 << 20;
+
+		// Fly across the terrain, chunks behind the camera are evicted as new ones come in
+		render_type rt = render_type::LIGHTED;
+		*point_light = (bmin + bmax) * .5f + V3(0.0f, extent[1] * 4.0f, 0.0f);
+		lights[0]->casts_shadows = false;
+		int num_frames = 600;
+		for (int fi = 0; fi < num_frames; fi++) {
+			float t = (float)fi / (float)(num_frames - 1);
+			V3 C = bmin + V3(extent[0] * t, extent[1] * 2.0f, extent[2] * .5f);
+			ppc->pose(C, C + V3(1.0f, -.5f, 0.0f), V3(0.0f, 1.0f, 0.0f));
+			render(rt);
+			if (fi % 60 == 0)
+				cerr << "INFO: terrain resident " << (terrain->get_resident_bytes() >> 10) << " KB" << endl;
+		}
+		return;
+	}
+	case 10: { //Directional light with cascaded shadows
+		ppc->translate(V3(0.0f, 75.0f, 300.0f));
+		sun_shadow_map = new DirectionalShadowMap(1024, 3, V3(-1.0f, -2.0f, -1.0f));
+
+		render_type rt = render_type::LIGHTED;
+		while (true) {
+			sun_shadow_map->set_dir(sun_shadow_map->dir.rotate_point(V3(), V3(0.0f, 1.0f, 0.0f), 1.0f));
+			render_sun_shadows();
+			render(rt);
+		}
+		return;
+	}
+	case 9: { //Many point lights with tiled light culling
+		ppc->translate(V3(0.0f, 75.0f, 300.0f));
+		*point_light = tms[0].get_center() + V3(0.0f, 100.0f, 0.0f);
+		lights[0]->casts_shadows = false;
+
+		// Ring of small colored pools of light over the ground quad
+		int num_ring_lights = 32;
+		for (int i = 0; i < num_ring_lights; i++) {
+			V3 pos = V3(80.0f, 5.0f, 0.0f).rotate_point(V3(), V3(0.0f, 1.0f, 0.0f), 360.0f * i / num_ring_lights);
+			add_light(pos, 40.0f, false);
+		}
+
+		render_type rt = render_type::LIGHTED;
+		while (true) {
+			for (int i = 1; i < (int)lights.size(); i++) {
+				lights[i]->pos = lights[i]->pos.rotate_point(V3(), V3(0.0f, 1.0f, 0.0f), 1.0f);
+			}
+			render_shadows();
+			render(rt);
+		}
+		return;
+	}
 	case 8: { //Tetris Game
 		fb->clear();
 		while (true) {
@@ -386,52 +444,26 @@ static void WriteName(int u, FrameBuffer *fb) {
 }
 
 TM* make_texture_tms() {
-	TM bricks_tm = TM();
-	bricks_tm.set_as_quad(V3(0.0f, 0.0f, 0.0f), V3(0.0f, 50.0f, 100.0f),
-		V3(100.0f, 50.0f, 0.0f), V3(100.0f, 0.0f, 100.0f), 0xFF000000);
-
-	FrameBuffer* bricks_tex = new FrameBuffer(0, 0, 100, 100);
-	bricks_tex->load_tiff("textures/bricks.tiff");
-	
-	TM flag_tm = TM();
-	flag_tm.set_as_quad(V3(0.0f, 0.0f, 0.0f), V3(0.0f, 50.0f, 100.0f),
-		V3(100.0f, 50.0f, 0.0f), V3(100.0f, 0.0f, 100.0f), 0xFF000000);
-
-	FrameBuffer* flag_tex = new FrameBuffer(0, 0, 100, 100);
-	flag_tex->load_tiff("textures/purdue.tiff");
-
-	TM face_tm = TM();
-	face_tm.set_as_quad(V3(0.0f, 0.0f, 0.0f), V3(0.0f, 50.0f, 100.0f),
-		V3(100.0f, 50.0f, 0.0f), V3(100.0f, 0.0f, 100.0f), 0xFF000000);
-
-	FrameBuffer* face_tex = new FrameBuffer(0, 0, 100, 100);
-	face_tex->load_tiff("textures/popescu.tiff");
-
-	TM box_tm = TM();
-	box_tm.set_as_quad(V3(0.0f, 0.0f, 0.0f), V3(0.0f, 50.0f, 100.0f),
-		V3(100.0f, 50.0f, 0.0f), V3(100.0f, 0.0f, 100.0f), 0xFF000000);
-
-	FrameBuffer* box_tex = new FrameBuffer(0, 0, 100, 100);
-	box_tex->load_tiff("textures/amazon.tiff");
+	TM* tms = new TM[4];
+	for (int i = 0; i < 4; i++) {
+		tms[i].set_as_quad(V3(0.0f, 0.0f, 0.0f), V3(0.0f, 50.0f, 100.0f),
+			V3(100.0f, 50.0f, 0.0f), V3(100.0f, 0.0f, 100.0f), 0xFF000000);
+	}
 
 	V3* tiling_tcs = new V3[4]{V3(0.0f, 0.0f, 0.0f), V3(0.0f, 4.0f, 0.0f), V3(4.0f, 0.0f, 0.0f), V3(4.0f, 4.0f, 0.0f)};
 	V3* tcs = new V3[4]{V3(0.0f, 0.0f, 0.0f), V3(0.0f, 1.0f, 0.0f), V3(1.0f, 0.0f, 0.0f), V3(1.0f, 1.0f, 0.0f)};
 
-	bricks_tm.set_tex(bricks_tex, tiling_tcs);
-	flag_tm.set_tex(flag_tex, tcs);
-	face_tm.set_tex(face_tex, tiling_tcs);
-	box_tm.set_tex(box_tex, tcs);
-
-	flag_tm.translate(V3(-150.0f, 0.0f, 0.0f));
-	face_tm.translate(V3(0.0f, 150.0f, 0.0f));
-	box_tm.translate(V3(150.0f, 0.0f, 0.0f));
-
-	TM* tms = new TM[4];
-
-	tms[0] = bricks_tm;
-	tms[1] = flag_tm;
-	tms[2] = face_tm;
-	tms[3] = box_tm;
+	// Decodes the four images in parallel, wait_all installs them as they finish
+	AssetLoader loader;
+	loader.load_texture(&tms[0], "textures/bricks.tiff", tiling_tcs);
+	loader.load_texture(&tms[1], "textures/room.tiff", tcs); // flag
+	loader.load_texture(&tms[2], "textures/popescu.tiff", tiling_tcs);
+	loader.load_texture(&tms[3], "textures/amazon.tiff", tcs);
+	loader.wait_all();
+
+	tms[1].translate(V3(-150.0f, 0.0f, 0.0f));
+	tms[2].translate(V3(0.0f, 150.0f, 0.0f));
+	tms[3].translate(V3(150.0f, 0.0f, 0.0f));
 
 	return tms;
 }
@@ -7,22 +7,15 @@
 #include "pong.h"
 #include "tetris.h"
 #include "hw_framebuffer.h"
+#include "renderer.h"
+#include "hud.h"
 
-class Scene {
+class Scene : public Renderer {
 public:
 	GUI* gui;
-	FrameBuffer* fb;
+	FrameBuffer* fb; // presents image, which is fb
 	HWFrameBuffer* hw_fb;
-	PPC* ppc;
-	V3* point_light;
-	int num_tms;
-	TM* tms;
-	ShadowMap* shadow_map;
-	CubeMap* cube_map;
-
-	bool render_light;
-	float ambient_factor;
-	int specular_exp;
+	V3* point_light; // position of lights[0]
 
 	bool mirror_tiling = false;
 	bool render_wireframe = false;
@@ -31,16 +24,17 @@ public:
 	PongGame* pong_game;
 	Tetris* tetris_game;
 
-	std::chrono::steady_clock::time_point last_frame_time;
+	bool show_hud = false;
+	Hud hud;
+	std::chrono::steady_clock::time_point last_frame_time; // when the previous frame finished, for the HUD
 
 	float mFraction = 0.0f;
 
 	Scene();
 	void DBG();
 	void NewButton();
-	void render(render_type rt);
-	void render_shadows();
-	void render(TM& tm, render_type rt);
+	using Renderer::render;
+	void render(render_type rt); // renders, then presents fb and hw_fb
 	void render_cameras_as_frames();
 
 };
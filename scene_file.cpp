@@ -0,0 +1,217 @@
+#include "scene_file.h"
+#include "asset_loader.h"
+#include "renderer.h"
+
+#include <cfloat>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct MeshEntry {
+	string fname; // empty for meshes built in place (quad, box)
+	TM tm; // meshes built in place
+	bool is_quad = false;
+	vector<function<void(TM&)>> transforms; // in file order
+	string texture;
+	float tiling = 1.0f;
+};
+
+bool read_v3(istringstream& iss, V3& v) {
+	return (bool)(iss >> v[0] >> v[1] >> v[2]);
+}
+
+bool read_color(istringstream& iss, unsigned int& color) {
+	string tok;
+	if (!(iss >> tok))
+		return false;
+	color = (unsigned int)strtoul(tok.c_str(), nullptr, 0);
+	return true;
+}
+
+}
+
+bool load_scene_file(char* fname, Renderer* scene, AssetLoader* loader, bool per_pixel_lighting) {
+	ifstream ifs(fname);
+	if (ifs.fail()) {
+		cerr << "ERROR: cannot open scene file " << fname << endl;
+		return false;
+	}
+
+	vector<MeshEntry> meshes;
+	int num_lights = 0;
+
+	string line;
+	int line_num = 0;
+	while (getline(ifs, line)) {
+		line_num++;
+		size_t comment = line.find('#');
+		if (comment != string::npos)
+			line.erase(comment);
+
+		istringstream iss(line);
+		string cmd;
+		if (!(iss >> cmd))
+			continue;
+
+		bool ok = true;
+		MeshEntry* last = meshes.empty() ? nullptr : &meshes.back();
+		bool needs_mesh = cmd == "texture" || cmd == "translate" || cmd == "position" || cmd == "scale" || cmd == "rotate";
+		if (needs_mesh && !last) {
+			cerr << "ERROR: " << fname << ":" << line_num << ": " << cmd << " before any mesh" << endl;
+			continue;
+		}
+
+		if (cmd == "mesh") {
+			MeshEntry entry;
+			ok = (bool)(iss >> entry.fname);
+			if (ok)
+				meshes.push_back(entry);
+		}
+		else if (cmd == "quad") {
+			V3 p1, p2, p3, p4;
+			unsigned int color;
+			ok = read_v3(iss, p1) && read_v3(iss, p2) && read_v3(iss, p3) && read_v3(iss, p4) && read_color(iss, color);
+			if (ok) {
+				meshes.push_back(MeshEntry());
+				meshes.back().tm.set_as_quad(p1, p2, p3, p4, color);
+				meshes.back().is_quad = true;
+			}
+		}
+		else if (cmd == "box") {
+			V3 p1, p2;
+			unsigned int color;
+			ok = read_v3(iss, p1) && read_v3(iss, p2) && read_color(iss, color);
+			if (ok) {
+				float step;
+				if (!(iss >> step) || step <= 0.0f)
+					step = per_pixel_lighting ? FLT_MAX : 2.0f;
+				meshes.push_back(MeshEntry());
+				meshes.back().tm.set_as_box(p1, p2, color, step);
+			}
+		}
+		else if (cmd == "texture") {
+			// Quads get texture coordinates below and files may have their own, boxes have none
+			if (last->fname.empty() && !last->is_quad) {
+				cerr << "ERROR: " << fname << ":" << line_num << ": texture needs a quad or a mesh file with texture coordinates" << endl;
+				continue;
+			}
+			ok = (bool)(iss >> last->texture);
+			if (ok && !(iss >> last->tiling))
+				last->tiling = 1.0f;
+		}
+		else if (cmd == "translate") {
+			V3 v;
+			ok = read_v3(iss, v);
+			if (ok)
+				last->transforms.push_back([v](TM& tm) { tm.translate(v); });
+		}
+		else if (cmd == "position") {
+			V3 p;
+			ok = read_v3(iss, p);
+			if (ok)
+				last->transforms.push_back([p](TM& tm) { tm.position(p); });
+		}
+		else if (cmd == "scale") {
+			float s;
+			ok = (bool)(iss >> s);
+			if (ok)
+				last->transforms.push_back([s](TM& tm) { tm.scale(s); });
+		}
+		else if (cmd == "rotate") {
+			V3 origin, axis;
+			float degrees;
+			ok = read_v3(iss, origin) && read_v3(iss, axis) && (iss >> degrees);
+			if (ok)
+				last->transforms.push_back([origin, axis, degrees](TM& tm) { tm.rotate_about_arbitrary_axis(origin, axis, degrees); });
+		}
+		else if (cmd == "light") {
+			V3 pos;
+			ok = read_v3(iss, pos);
+			string radius_tok;
+			float radius = FLT_MAX;
+			if (iss >> radius_tok && radius_tok != "inf")
+				radius = (float)atof(radius_tok.c_str());
+			int shadows = 1;
+			iss >> shadows;
+
+			// The first light is the primary light the scene already created
+			if (ok && num_lights == 0 && !scene->lights.empty()) {
+				scene->lights[0]->pos = pos;
+				scene->lights[0]->radius = radius;
+				scene->lights[0]->casts_shadows = shadows != 0;
+			}
+			else if (ok) {
+				scene->add_light(pos, radius, shadows != 0);
+			}
+			num_lights++;
+		}
+		else if (cmd == "camera") {
+			float hfov;
+			V3 eye, look_at;
+			ok = (iss >> hfov) && read_v3(iss, eye) && read_v3(iss, look_at);
+			if (ok) {
+				*scene->ppc = PPC(hfov, scene->ppc->w, scene->ppc->h);
+				scene->ppc->pose(eye, look_at, V3(0.0f, 1.0f, 0.0f));
+			}
+		}
+		else if (cmd == "cameras") {
+			ok = (bool)(iss >> scene->camera_path);
+		}
+		else if (cmd == "environment") {
+			string env;
+			ok = (bool)(iss >> env);
+			if (ok)
+				loader->load_cube_map(&scene->cube_map, env);
+		}
+		else {
+			cerr << "ERROR: " << fname << ":" << line_num << ": unknown command " << cmd << endl;
+			continue;
+		}
+
+		if (!ok)
+			cerr << "ERROR: " << fname << ":" << line_num << ": cannot parse " << cmd << endl;
+	}
+
+	scene->num_tms = (int)meshes.size();
+	scene->tms = new TM[scene->num_tms];
+
+	for (int i = 0; i < scene->num_tms; i++) {
+		MeshEntry& entry = meshes[i];
+		TM* tm = &scene->tms[i];
+
+		V3* tcs = nullptr;
+		if (entry.is_quad && !entry.texture.empty()) {
+			// Same corner order as set_as_quad
+			float t = entry.tiling;
+			tcs = new V3[4]{ V3(0.0f, 0.0f, 0.0f), V3(0.0f, t, 0.0f), V3(t, 0.0f, 0.0f), V3(t, t, 0.0f) };
+		}
+
+		if (entry.fname.empty()) {
+			for (function<void(TM&)>& transform : entry.transforms) {
+				transform(entry.tm);
+			}
+			*tm = entry.tm;
+		}
+		else {
+			vector<function<void(TM&)>> transforms = entry.transforms;
+			loader->load_mesh(tm, entry.fname, [transforms](TM& loaded) {
+				for (const function<void(TM&)>& transform : transforms) {
+					transform(loaded);
+				}
+			});
+		}
+
+		if (!entry.texture.empty())
+			loader->load_texture(tm, entry.texture, tcs);
+	}
+
+	return true;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+class Renderer;
+class AssetLoader;
+
+// Reads a scene description (see scenes/default.scene for the commands) and replaces the
+// meshes of scene with the ones it lists. Meshes and textures are handed to loader, so
+// this returns before they are read and the scene fills in as loader->poll() installs them.
+// per_pixel_lighting builds boxes without a step with one quad per face, the fine grid is
+// only there so per-vertex lighting has vertices to light.
+bool load_scene_file(char* fname, Renderer* scene, AssetLoader* loader, bool per_pixel_lighting = false);
@@ -1,11 +1,13 @@
 #include "shadow_map.h"
 #include "tm.h"
+#include "trace.h"
 #include <cmath>
 
 ShadowMap::ShadowMap(int _w, int _h, V3 _light_pos) {
 	w = _w;
 	h = _h;
 	pos = _light_pos;
+	version = 0;
 	
 	cube_map = new CubeMap(w, h, pos);
 
@@ -13,13 +15,18 @@ ShadowMap::ShadowMap(int _w, int _h, V3 _light_pos) {
 }
 
 void ShadowMap::set_pos(V3 new_pos) {
+	if (new_pos == pos)
+		return;
+
 	pos = new_pos;
+	version++;
 	for (int i = 0; i < 6; i++) {
 		cube_map->ppcs[i]->C = pos;
 	}
 }
 
 void ShadowMap::clear() {
+	version++;
 	for (int i = 0; i < 6; i++) {
 		cube_map->faces[i]->clear();
 	}
@@ -74,7 +81,8 @@ bool ShadowMap::in_shadow(V3 P) {
 }
 
 void ShadowMap::add_tm(TM* tm) {
+	TraceScope trace("ShadowMap::add_tm");
 	for (int vi = 0; vi < tm->num_verts; vi++) {
-		project_and_set(tm->verts[vi]);
+		project_and_set(tm->get_vert(vi));
 	}
 }
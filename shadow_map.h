@@ -10,6 +10,7 @@ public:
 	int w, h;
 	CubeMap* cube_map; // 6 faces
 	V3 pos;
+	unsigned int version; // bumped when pos or the depth contents change
 
 	ShadowMap(int _w, int _h, V3 _light_pos);
 
@@ -0,0 +1,174 @@
+#include "streaming_mesh.h"
+#include "tm.h"
+#include "ppc.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+
+StreamingMesh::StreamingMesh(size_t _memory_budget, float _load_distance) {
+	memory_budget = _memory_budget;
+	load_distance = _load_distance;
+	resident_bytes = 0;
+	stopping = false;
+}
+
+StreamingMesh::~StreamingMesh() {
+	{
+		lock_guard<mutex> lock(mtx);
+		stopping = true;
+	}
+	cv.notify_all();
+	if (io_thread.joinable())
+		io_thread.join();
+
+	for (auto& done : completed) {
+		if (done.second) {
+			done.second->release();
+			delete done.second;
+		}
+	}
+	for (int ci = 0; ci < (int)chunks.size(); ci++) {
+		if (chunks[ci].state == chunk_state::RESIDENT)
+			evict(ci);
+	}
+}
+
+bool StreamingMesh::open(char* fname) {
+	if (!file.open(fname))
+		return false;
+
+	chunks.assign(file.chunks.size(), Chunk());
+	for (int ci = 0; ci < (int)chunks.size(); ci++) {
+		ChunkRecord& r = file.chunks[ci];
+		// file data plus the projected verts and lighted colors allocated per chunk
+		chunks[ci].bytes = (size_t)r.size + 2 * (size_t)r.num_verts * sizeof(V3);
+	}
+
+	io_thread = thread(&StreamingMesh::io_loop, this);
+
+	cerr << "INFO: streaming " << chunks.size() << " chunks from " << fname << endl;
+	return true;
+}
+
+void StreamingMesh::io_loop() {
+	while (true) {
+		int ci;
+		{
+			unique_lock<mutex> lock(mtx);
+			cv.wait(lock, [this] { return stopping || !requests.empty(); });
+			if (stopping)
+				return;
+			ci = requests.front();
+			requests.pop_front();
+		}
+
+		TM* tm = new TM();
+		if (file.read_chunk(ci, tm->verts, tm->colors, tm->normals, tm->tris)) {
+			ChunkRecord& r = file.chunks[ci];
+			tm->num_verts = (int)r.num_verts;
+			tm->num_tris = (int)r.num_tris;
+			tm->projected_verts = new V3[tm->num_verts];
+			tm->mark_geometry_changed();
+		}
+		else {
+			delete tm;
+			tm = nullptr;
+		}
+
+		lock_guard<mutex> lock(mtx);
+		completed.push_back(make_pair(ci, tm));
+	}
+}
+
+void StreamingMesh::evict(int ci) {
+	Chunk& chunk = chunks[ci];
+	chunk.tm->release();
+	delete chunk.tm;
+	chunk.tm = nullptr;
+	chunk.state = chunk_state::UNLOADED;
+	resident_bytes -= chunk.bytes;
+}
+
+void StreamingMesh::update(PPC* ppc) {
+	if (chunks.empty())
+		return;
+
+	vector<pair<int, TM*>> finished;
+	{
+		lock_guard<mutex> lock(mtx);
+		finished.assign(completed.begin(), completed.end());
+		completed.clear();
+	}
+	for (auto& done : finished) {
+		Chunk& chunk = chunks[done.first];
+		if (!done.second) {
+			chunk.state = chunk_state::UNLOADED;
+			continue;
+		}
+		chunk.tm = done.second;
+		chunk.state = chunk_state::RESIDENT;
+		resident_bytes += chunk.bytes;
+	}
+
+	// Distance from the camera to the closest point of each chunk's bounds
+	vector<int> order(chunks.size());
+	for (int ci = 0; ci < (int)chunks.size(); ci++) {
+		ChunkRecord& r = file.chunks[ci];
+		float d2 = 0.0f;
+		for (int i = 0; i < 3; i++) {
+			float d = fmaxf(fmaxf(r.bounds_min[i] - ppc->C[i], 0.0f), ppc->C[i] - r.bounds_max[i]);
+			d2 += d * d;
+		}
+		chunks[ci].distance = sqrtf(d2);
+		order[ci] = ci;
+	}
+	sort(order.begin(), order.end(), [this](int c0, int c1) { return chunks[c0].distance < chunks[c1].distance; });
+
+	// The nearest chunks that fit in the budget are the ones we want resident
+	vector<bool> wanted(chunks.size(), false);
+	size_t wanted_bytes = 0;
+	for (int ci : order) {
+		if (chunks[ci].distance > load_distance || file.chunks[ci].num_tris == 0)
+			continue;
+		if (wanted_bytes + chunks[ci].bytes > memory_budget)
+			break;
+		wanted[ci] = true;
+		wanted_bytes += chunks[ci].bytes;
+	}
+
+	for (int ci = 0; ci < (int)chunks.size(); ci++) {
+		if (chunks[ci].state == chunk_state::RESIDENT && !wanted[ci])
+			evict(ci);
+	}
+
+	{
+		lock_guard<mutex> lock(mtx);
+
+		// Requests that fell out of the wanted set are dropped before they are read
+		for (int ci : requests) {
+			chunks[ci].state = chunk_state::UNLOADED;
+		}
+		requests.clear();
+
+		for (int ci : order) {
+			if (!wanted[ci])
+				continue;
+			if (chunks[ci].state == chunk_state::UNLOADED) {
+				chunks[ci].state = chunk_state::QUEUED;
+				requests.push_back(ci);
+			}
+		}
+	}
+	cv.notify_one();
+}
+
+void StreamingMesh::get_resident(vector<TM*>& tms) {
+	tms.clear();
+	for (Chunk& chunk : chunks) {
+		if (chunk.state == chunk_state::RESIDENT)
+			tms.push_back(chunk.tm);
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "chunked_mesh.h"
+
+class TM;
+class PPC;
+
+// Out-of-core mesh for terrains larger than memory. Chunks of a .gpc file are kept
+// resident nearest to the camera first, within a fixed memory budget. Reads happen on
+// a dedicated I/O thread, so a frame never waits on the disk, a chunk simply shows up
+// once it has been read.
+class StreamingMesh {
+public:
+	ChunkedMeshFile file;
+	size_t memory_budget; // bytes of resident chunk data, including per-frame arrays
+	float load_distance; // chunks farther than this from the camera are never requested
+
+	StreamingMesh(size_t _memory_budget, float _load_distance);
+	~StreamingMesh();
+
+	bool open(char* fname);
+
+	// Installs finished reads, then evicts and requests chunks by distance to ppc. Call once per frame.
+	void update(PPC* ppc);
+
+	void get_resident(std::vector<TM*>& tms); // chunk meshes ready to render
+	size_t get_resident_bytes() { return resident_bytes; }
+
+private:
+	enum class chunk_state {
+		UNLOADED,
+		QUEUED, // requested or being read
+		RESIDENT
+	};
+
+	struct Chunk {
+		chunk_state state = chunk_state::UNLOADED;
+		TM* tm = nullptr;
+		size_t bytes = 0; // memory once resident
+		float distance = 0.0f;
+	};
+
+	std::vector<Chunk> chunks;
+	size_t resident_bytes;
+
+	std::thread io_thread;
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::deque<int> requests; // nearest first
+	std::deque<std::pair<int, TM*>> completed; // null TM when the read failed
+	bool stopping;
+
+	void io_loop();
+	void evict(int ci);
+};
@@ -0,0 +1,151 @@
+#include "texture_file.h"
+
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+using namespace std;
+
+static uint64_t align_offset(uint64_t offset) {
+	return (offset + texture_file_alignment - 1) / texture_file_alignment * texture_file_alignment;
+}
+
+TextureFile::TextureFile() {
+	header = nullptr;
+}
+
+bool TextureFile::open(char* fname) {
+	header = nullptr;
+	if (!file.open(fname))
+		return false;
+
+	if (file.size < sizeof(TextureFileHeader)) {
+		cerr << "ERROR: file " << fname << " is too small to be a texture file" << endl;
+		file.close();
+		return false;
+	}
+
+	TextureFileHeader* h = (TextureFileHeader*)file.data;
+	if (h->magic != texture_file_magic) {
+		cerr << "ERROR: file " << fname << " is not a texture file" << endl;
+		file.close();
+		return false;
+	}
+	if (h->version < texture_file_version) {
+		// the asset cache writes it again from the source image
+		cerr << "INFO: texture file " << fname << " is from an older version" << endl;
+		file.close();
+		return false;
+	}
+	if (h->version != texture_file_version || h->header_size < sizeof(TextureFileHeader)) {
+		cerr << "ERROR: texture file " << fname << " has unsupported version " << h->version << endl;
+		file.close();
+		return false;
+	}
+
+	uint64_t bytes = (uint64_t)h->w * h->h * sizeof(unsigned int);
+	bool valid = h->w > 0 && h->h > 0 && h->texels_offset % texture_file_alignment == 0 &&
+		h->texels_offset <= file.size && bytes <= file.size - h->texels_offset;
+	if (!valid) {
+		cerr << "ERROR: texture file " << fname << " is corrupt" << endl;
+		file.close();
+		return false;
+	}
+
+	header = h;
+	return true;
+}
+
+int TextureFile::get_width() {
+	return header ? (int)header->w : 0;
+}
+
+int TextureFile::get_height() {
+	return header ? (int)header->h : 0;
+}
+
+const unsigned int* TextureFile::get_texels() {
+	if (!header)
+		return nullptr;
+	return (const unsigned int*)(file.data + header->texels_offset);
+}
+
+bool TextureFile::write(char* fname, const unsigned int* pix, int w, int h,
+	uint64_t source_size, int64_t source_mtime) {
+	if (!pix || w <= 0 || h <= 0) {
+		cerr << "ERROR: cannot write empty texture to " << fname << endl;
+		return false;
+	}
+
+	TextureFileHeader header = {};
+	header.magic = texture_file_magic;
+	header.version = texture_file_version;
+	header.header_size = sizeof(TextureFileHeader);
+	header.w = (uint32_t)w;
+	header.h = (uint32_t)h;
+	header.source_size = source_size;
+	header.source_mtime = source_mtime;
+	header.texels_offset = align_offset(sizeof(TextureFileHeader));
+
+	// Unique per thread, two loads of the same image may both write it
+	string temp_fname = string(fname) + "." + to_string(hash<thread::id>()(this_thread::get_id())) + ".tmp";
+	{
+		ofstream ofs(temp_fname.c_str(), ios::binary);
+		if (ofs.fail()) {
+			cerr << "ERROR: cannot open file for writing: " << temp_fname << endl;
+			return false;
+		}
+
+		char padding[texture_file_alignment] = {};
+		ofs.write((const char*)&header, sizeof(header));
+		ofs.write(padding, (streamsize)(header.texels_offset - sizeof(header)));
+		ofs.write((const char*)pix, (streamsize)((uint64_t)w * h * sizeof(unsigned int)));
+
+		if (ofs.fail()) {
+			cerr << "ERROR: failed writing texture file " << temp_fname << endl;
+			ofs.close();
+			remove(temp_fname.c_str());
+			return false;
+		}
+	}
+
+	// rename does not replace an existing file on Windows
+	if (rename(temp_fname.c_str(), fname) != 0) {
+		remove(fname);
+		if (rename(temp_fname.c_str(), fname) != 0) {
+			cerr << "ERROR: cannot rename " << temp_fname << " to " << fname << endl;
+			remove(temp_fname.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+string get_texture_file_path(const string& image_fname) {
+	size_t dot = image_fname.find_last_of('.');
+	size_t slash = image_fname.find_last_of("/\\");
+	if (dot == string::npos || (slash != string::npos && dot < slash))
+		return image_fname + ".gpt";
+	return image_fname.substr(0, dot) + ".gpt";
+}
+
+bool get_file_stamp(const char* fname, uint64_t& size, int64_t& mtime) {
+#ifdef _WIN32
+	struct _stat64 st;
+	if (_stat64(fname, &st) != 0)
+		return false;
+#else
+	struct stat st;
+	if (stat(fname, &st) != 0)
+		return false;
+#endif
+	size = (uint64_t)st.st_size;
+	mtime = (int64_t)st.st_mtime;
+	return true;
+}
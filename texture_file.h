@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "mapped_file.h"
+
+// Pre-decoded texture container, .gpt files. A fixed header followed by the RGBA8 texels,
+// starting at a multiple of texture_file_alignment so a mapped file is used without a
+// decode. Rows are stored bottom row first like Image::pix. The first time an image
+// is loaded through the asset cache its .gpt is written next to it, later loads map that.
+
+const uint32_t texture_file_magic = 0x54504723; // "#GPT"
+const uint32_t texture_file_version = 2; // 2 dropped the unused mip and tile layouts
+const uint32_t texture_file_alignment = 64;
+
+struct TextureFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t header_size; // sizeof(TextureFileHeader) of the writer
+	uint32_t flags; // none defined yet, 0
+	uint32_t w, h;
+
+	// size and modification time of the image the texels were decoded from, a mismatch means the .gpt is stale
+	uint64_t source_size;
+	int64_t source_mtime;
+
+	uint64_t texels_offset; // byte offset from the start of the file
+};
+
+class TextureFile {
+public:
+	MappedFile file;
+	TextureFileHeader* header; // null until open succeeds
+
+	TextureFile();
+
+	bool open(char* fname); // maps fname read-only
+
+	int get_width();
+	int get_height();
+	const unsigned int* get_texels(); // inside the mapping, row by row, bottom row first
+
+	// Writes a temporary file next to fname and renames it over fname, so a crash while
+	// writing never leaves a partial .gpt behind
+	static bool write(char* fname, const unsigned int* pix, int w, int h,
+		uint64_t source_size, int64_t source_mtime);
+};
+
+std::string get_texture_file_path(const std::string& image_fname); // textures/a.tiff -> textures/a.gpt
+bool get_file_stamp(const char* fname, uint64_t& size, int64_t& mtime);
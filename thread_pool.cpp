@@ -0,0 +1,124 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+using namespace std;
+
+ThreadPool::ThreadPool(int num_threads) {
+	stopping = false;
+
+	if (num_threads <= 0) {
+		num_threads = (int)thread::hardware_concurrency() - 1;
+	}
+	num_threads = max(0, num_threads);
+
+	for (int i = 0; i < num_threads; i++) {
+		workers.push_back(thread(&ThreadPool::worker_loop, this));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		lock_guard<mutex> lock(mtx);
+		stopping = true;
+	}
+	cv.notify_all();
+
+	for (thread& t : workers) {
+		t.join();
+	}
+}
+
+int ThreadPool::num_workers() {
+	return (int)workers.size();
+}
+
+void ThreadPool::enqueue(function<void()> task) {
+	{
+		lock_guard<mutex> lock(mtx);
+		tasks.push_back(move(task));
+	}
+	cv.notify_one();
+}
+
+void ThreadPool::worker_loop() {
+	while (true) {
+		function<void()> task;
+		{
+			unique_lock<mutex> lock(mtx);
+			cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+			if (stopping && tasks.empty())
+				return;
+			task = move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
+
+void ThreadPool::parallel_for(int count, int grain, const function<void(int, int)>& fn) {
+	if (count <= 0)
+		return;
+
+	grain = max(1, grain);
+	int num_ranges = min(num_workers() + 1, (count + grain - 1) / grain);
+
+	if (num_ranges <= 1) {
+		fn(0, count);
+		return;
+	}
+
+	int range_size = (count + num_ranges - 1) / num_ranges;
+
+	//Shared with the queued tasks so the counters outlive this call if a task starts late.
+	//Ranges are claimed from next, so the caller only ever runs and waits for its own ranges,
+	//never an unrelated task that happens to be queued (a whole render slot or asset decode).
+	//A task that starts after every range is claimed returns without touching fn.
+	struct Progress {
+		atomic<int> next;
+		atomic<int> remaining;
+		mutex mtx;
+		condition_variable cv;
+	};
+	shared_ptr<Progress> progress = make_shared<Progress>();
+	progress->next = 0;
+	progress->remaining = num_ranges;
+
+	auto run_ranges = [progress, &fn, count, num_ranges, range_size] {
+		while (true) {
+			int r = progress->next++;
+			if (r >= num_ranges)
+				return;
+			int begin = r * range_size;
+			int end = min(count, begin + range_size);
+			if (begin < end)
+				fn(begin, end);
+			if (--progress->remaining == 0) {
+				lock_guard<mutex> lock(progress->mtx);
+				progress->cv.notify_all();
+			}
+		}
+	};
+
+	for (int r = 1; r < num_ranges; r++) {
+		enqueue(run_ranges);
+	}
+
+	run_ranges();
+
+	//Whatever is left is running on other threads
+	unique_lock<mutex> lock(progress->mtx);
+	progress->cv.wait(lock, [&progress] { return progress->remaining == 0; });
+}
+
+ThreadPool* thread_pool() {
+	static ThreadPool pool;
+	return &pool;
+}
+
+ThreadPool* io_pool() {
+	static ThreadPool pool(max(2, (int)thread::hardware_concurrency() / 2));
+	return &pool;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+	ThreadPool(int num_threads = 0); //0 uses one worker per hardware thread, minus the caller
+	~ThreadPool();
+
+	int num_workers();
+
+	void enqueue(std::function<void()> task);
+
+	//Splits [0, count) into contiguous ranges of at least grain items and calls fn(begin, end)
+	//for each range across the workers. The calling thread works on ranges too and only
+	//returns once every range is done. It never runs other queued tasks while it waits, and
+	//runs every range itself if no worker is free, so this is safe to call from inside a worker.
+	void parallel_for(int count, int grain, const std::function<void(int, int)>& fn);
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mtx;
+	std::condition_variable cv;
+	bool stopping;
+
+	void worker_loop();
+};
+
+ThreadPool* thread_pool(); //Shared pool used by the software pipeline
+ThreadPool* io_pool(); //Asset loads and decodes, kept off the pipeline pool so frames never wait on them
@@ -1,14 +1,34 @@
 #pragma once
 
 #include "v3.h"
-#include "framebuffer.h"
+#include "affine.h"
+#include "image.h"
 #include "ppc.h"
 #include "shadow_map.h"
+#include "directional_shadow_map.h"
+#include "light.h"
+#include "mesh_file.h"
+#include "quantized_mesh.h"
 
 class CubeMap;
+struct PixelLighting;
+
+//Inputs the cached lighting terms of a TM were computed with
+struct LightingCache {
+	bool valid = false;
+	int num_verts = 0;
+	unsigned int geometry_version = 0;
+	unsigned int shadow_version = 0;
+	bool shadows = false;
+	V3 light_pos;
+	V3 eye_pos;
+	float ka = 0.0f;
+	int specular_exp = 0;
+};
 
 enum class render_type {
 	LIGHTED,
+	PIXEL_LIGHTED, // per-pixel (Phong) lighting
 	NOT_LIGHTED,
 	NORMAL_TILING_TEXTURED,
 	MIRRORED_TILING_TEXTURED,
@@ -30,12 +50,27 @@ public:
 	V3* normals; // per-vertex normals
 
 	V3* tcs; // texture coordinates per vertex
-	FrameBuffer* tex; // texture map
+	Image* tex; // texture map
+
+	unsigned int tex_id; // OpenGL texture ID, set by HWFrameBuffer
+
+	unsigned int geometry_version; // bumped whenever verts, normals or colors change
+
+	// per-vertex lighting terms kept between frames, see light_point
+	float* diffuse_terms;
+	float* specular_terms;
+	unsigned char* shadowed;
+	LightingCache lighting_cache;
 
-	GLuint tex_id; // OpenGL texture ID
+	MeshFile* mesh_file; // when loaded from a .gpm file, verts, colors, normals and tcs point into its mapping
+	QuantizedMesh* quantized; // when set and verts is null, the mesh only exists in quantized form, see quantize
+	bool owns_attributes; // verts, colors and normals are heap arrays that release frees, false while they point into a mapping or another mesh
+	bool owns_tris; // same for tris, mapped files with 16 bit indices are widened into a heap array
 
-	TM() : verts(0), projected_verts(0), num_verts(0), lighted_colors(0), colors(0), tris(0), num_tris(0), normals(0), tcs(0), tex(0) {};
-	TM(char* fname);
+	TM() : verts(0), projected_verts(0), num_verts(0), lighted_colors(0), colors(0), tris(0), num_tris(0), normals(0), tcs(0), tex(0),
+		geometry_version(0), diffuse_terms(0), specular_terms(0), shadowed(0), mesh_file(0), quantized(0),
+		owns_attributes(true), owns_tris(true) {};
+	TM(char* fname); // .gpm files are mapped with load_mesh_file, anything else goes through load_bin
 
 	//Cylinder constructor
 	TM(V3 center, float radius, float height, int _num_verts, unsigned int color);
@@ -44,34 +79,60 @@ public:
 	TM(V3 p1, V3 p2, unsigned int color);
 
 	void load_bin(char *fname); // load from file
+	bool load_mesh_file(char* fname); // maps a .gpm file, no copies except for 16 bit indices
+	bool save_mesh_file(char* fname, bool allow_16bit_indices = true); // writes a quantized file when the mesh is quantized
 
-	void set_tex(FrameBuffer* fb, V3* tcs);
+	// Replaces verts, colors, normals and tris with the compact QuantizedMesh encoding. Rendering
+	// decodes it while projecting and lighting decodes into a scratch copy per pass; translations
+	// and uniform scales only move the bounds. Other transforms call dequantize first, which
+	// expands the float attributes back.
+	void quantize();
+	void dequantize(); // no-op unless the mesh is quantized
+
+	V3 get_vert(int vi) { return verts ? verts[vi] : quantized->decode_position(vi); }
+	unsigned int get_index(int i) { return tris ? tris[i] : quantized->get_index(i); }
+
+	void set_tex(Image* tex, V3* tcs);
 
 	void draw_points(unsigned int color, int psize, PPC *ppc,
-		FrameBuffer *fb);
+		Image *fb);
 	void rotate_about_arbitrary_axis(V3 aO, V3 ad, float angle_degrees);
 
 	V3 get_center(); // return the average of all vertices
 
-	void set_as_box(V3 p1, V3 p2, unsigned int color); 
-	void set_as_plane(V3 p1, V3 p2, unsigned int color);
+	// step is the grid spacing, per-vertex lighting needs a fine grid for highlights, PIXEL_LIGHTED does not
+	void set_as_box(V3 p1, V3 p2, unsigned int color, float step = 2.0f); 
+	void set_as_plane(V3 p1, V3 p2, unsigned int color, float step = 2.0f);
 	void set_as_quad(V3 p1, V3 p2, V3 p3, V3 p4, unsigned int color);
     void get_bounding_box(V3& p1, V3& p2); // return p1, p2 via reference
+	// Applies xf to the positions and the normals in one pass, rotate_about_arbitrary_axis,
+	// translate and scale are built on it. Compose them with Affine::operator* to edit a mesh once.
+	void transform(const Affine& xf);
 	void translate(V3 tv);
 	void position(V3 new_center);
 	void scale(float s);
-
-	void render_as_wireframe(PPC *ppc, FrameBuffer* fb, bool is_lighted);
-	void rasterize(PPC* ppc, FrameBuffer* fb, CubeMap* cube_map, render_type rt);
+	void mark_geometry_changed(); // call after editing verts, normals or colors directly
+	TM clone(); // deep copy with its own arrays, quantized meshes come back expanded; tex is shared
+	// Copy that uses this mesh's verts, colors, normals, tris and quantized streams in place, only
+	// the per-frame arrays are its own. The shared arrays are copied the first time it is edited
+	// (see own_attributes), and have to outlive it until then.
+	TM share();
+	void own_attributes(); // copies shared verts, colors and normals to the heap, mapped files of our own are left in place
+	void release(); // frees the arrays and empties the mesh, only when no copy shares them; tcs and tex are not freed
+
+	void render_as_wireframe(PPC *ppc, Image* fb, bool is_lighted);
+	void rasterize(PPC* ppc, Image* fb, CubeMap* cube_map, render_type rt, PixelLighting* pixel_lighting = nullptr);
 
 	void set_eeqs(M33 proj_verts, M33& eeqs);
 
-	void visualize_normals(float nl, PPC* ppc, FrameBuffer* fb);
+	void visualize_normals(float nl, PPC* ppc, Image* fb);
 
-	void light_directional(ShadowMap* shadow_map, V3 eye_pos, float ka, int specular_exp);
-	void light_point(ShadowMap* shadow_map, V3 eye_pos, float ka, int specular_exp);
+	void light_directional(DirectionalShadowMap* shadow_map, V3 eye_pos, float ka, int specular_exp);
+	void light_point(ShadowMap* shadow_map, V3 eye_pos, float ka, int specular_exp, bool use_shadows = true); // light at shadow_map->pos
+	void light_points(std::vector<PointLight*>& lights, LightGrid* grid, PPC* ppc, float ka, int specular_exp);
 
 private:
+	void rasterize_quantized(PPC* ppc, Image* fb, CubeMap* cube_map, render_type rt, PixelLighting* pixel_lighting);
     void create_face(V3 origin, V3 u_dir, V3 v_dir, int u_steps, int v_steps, V3 normal, 
         const V3& color_vector, int& v_idx, int& t_idx);
 };
@@ -0,0 +1,99 @@
+#include "trace.h"
+
+#include <cstdio>
+#include <iostream>
+
+using namespace std;
+
+Tracer::Tracer() {
+	recording = false;
+	epoch = chrono::steady_clock::now();
+}
+
+void Tracer::start() {
+	lock_guard<mutex> lock(mtx);
+	for (auto& thread_trace : threads) {
+		lock_guard<mutex> thread_lock(thread_trace->mtx);
+		thread_trace->events.clear();
+	}
+	epoch = chrono::steady_clock::now();
+	recording = true;
+}
+
+void Tracer::stop() {
+	recording = false;
+}
+
+Tracer::ThreadTrace* Tracer::get_thread_trace() {
+	// One buffer per thread and tracer, there is only the one tracer in practice
+	thread_local ThreadTrace* thread_trace = nullptr;
+	thread_local Tracer* owner = nullptr;
+	if (thread_trace && owner == this)
+		return thread_trace;
+
+	lock_guard<mutex> lock(mtx);
+	threads.push_back(unique_ptr<ThreadTrace>(new ThreadTrace()));
+	thread_trace = threads.back().get();
+	thread_trace->tid = (int)threads.size();
+	owner = this;
+	return thread_trace;
+}
+
+void Tracer::record(const char* name, chrono::steady_clock::time_point start, chrono::steady_clock::time_point end) {
+	if (!is_recording())
+		return;
+
+	TraceEvent event;
+	event.name = name;
+	event.start_us = chrono::duration<double, micro>(start - epoch).count();
+	event.duration_us = chrono::duration<double, micro>(end - start).count();
+
+	ThreadTrace* thread_trace = get_thread_trace();
+	lock_guard<mutex> lock(thread_trace->mtx);
+	thread_trace->events.push_back(event);
+}
+
+void Tracer::set_thread_name(const string& name) {
+	ThreadTrace* thread_trace = get_thread_trace();
+	lock_guard<mutex> lock(thread_trace->mtx);
+	thread_trace->name = name;
+}
+
+bool Tracer::save(const string& fname) {
+	FILE* out = fopen(fname.c_str(), "w");
+	if (!out) {
+		cerr << "ERROR: cannot open " << fname << " for writing" << endl;
+		return false;
+	}
+
+	// Complete ("X") events, one per scope, plus a name record per thread
+	fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	bool first = true;
+	size_t num_events = 0;
+	lock_guard<mutex> lock(mtx);
+	for (auto& thread_trace : threads) {
+		lock_guard<mutex> thread_lock(thread_trace->mtx);
+		string name = thread_trace->name.empty() ? "thread " + to_string(thread_trace->tid) : thread_trace->name;
+		fprintf(out, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+			first ? "" : ",\n", thread_trace->tid, name.c_str());
+		first = false;
+
+		for (const TraceEvent& event : thread_trace->events) {
+			fprintf(out, ",\n{\"name\": \"%s\", \"cat\": \"render\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+				event.name, thread_trace->tid, event.start_us, event.duration_us);
+		}
+		num_events += thread_trace->events.size();
+	}
+	fprintf(out, "\n]}\n");
+
+	bool ok = ferror(out) == 0;
+	fclose(out);
+	if (ok)
+		cerr << "INFO: wrote " << num_events << " trace events to " << fname << endl;
+	return ok;
+}
+
+Tracer* tracer() {
+	static Tracer instance;
+	return &instance;
+}
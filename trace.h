@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Timeline of what every thread did, saved as Chrome trace-event JSON for chrome://tracing or
+// ui.perfetto.dev. Unlike the profiler this is always compiled in and only records between
+// start() and stop(), so it can look at release builds; the scopes are per pass and per mesh,
+// never per triangle, so a disabled tracer costs one flag test per scope.
+class Tracer {
+public:
+	Tracer();
+
+	void start(); // drops anything recorded before
+	void stop();
+	bool is_recording() { return recording.load(std::memory_order_relaxed); }
+
+	// name has to outlive the tracer, string literals in practice
+	void record(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+	void set_thread_name(const std::string& name); // for the calling thread, shown instead of its number
+
+	bool save(const std::string& fname);
+
+private:
+	struct TraceEvent {
+		const char* name;
+		double start_us, duration_us;
+	};
+
+	// Each thread appends to its own buffer, the lock is only contended while saving
+	struct ThreadTrace {
+		int tid;
+		std::string name;
+		std::mutex mtx;
+		std::vector<TraceEvent> events;
+	};
+
+	std::atomic<bool> recording;
+	std::chrono::steady_clock::time_point epoch;
+	std::mutex mtx;
+	std::vector<std::unique_ptr<ThreadTrace>> threads; // kept until the tracer goes away, threads may exit first
+
+	ThreadTrace* get_thread_trace();
+};
+
+Tracer* tracer();
+
+class TraceScope {
+public:
+	TraceScope(const char* _name) : name(_name), active(tracer()->is_recording()) {
+		if (active)
+			start = std::chrono::steady_clock::now();
+	}
+	~TraceScope() {
+		if (active)
+			tracer()->record(name, start, std::chrono::steady_clock::now());
+	}
+
+private:
+	const char* name;
+	bool active;
+	std::chrono::steady_clock::time_point start;
+};
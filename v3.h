@@ -1,49 +1,126 @@
 #pragma once
 
+#include <cmath>
 #include <ostream>
 #include <istream>
 
+#if defined(_M_X64) || defined(__SSE2__)
+#define GP_SSE 1
+#include <emmintrin.h>
+#else
+#define GP_SSE 0
+#endif
 
 using namespace std;
 
+// Header only so every operator inlines into the rasterizer and lighting loops. V3 stays three
+// packed floats, mesh files and the GL vertex arrays map arrays of it directly. Nothing here
+// throws: dividing by zero gives inf like a float would and a zero vector normalizes to zero.
 class V3 {
 public:
 	float xyz[3] = { 0.0f, 0.0f, 0.0f };
-	V3();
-	V3(float x, float y, float z);
 
-	float& operator[](int i);
+	constexpr V3() {}
+	constexpr V3(float x, float y, float z) : xyz{ x, y, z } {}
 
-	V3 operator+(V3 v2);
-	V3& operator+=(V3 v2);
-	V3 operator-(V3 v2);
-	V3& operator-=(V3 v2);
+	float& operator[](int i) { return xyz[i]; }
+	constexpr float operator[](int i) const { return xyz[i]; }
 
-	float operator*(V3 v2);
-	V3 operator^(V3 v2);
-	V3 operator*(float scalar);
-	V3& operator*=(float scalar);
-	friend V3 operator*(float scalar, V3 v); // Scalar multiplication from left
-	V3 operator/(float scalar);
-	V3& operator/=(float scalar);
+	constexpr V3 operator+(const V3& v2) const { return V3(xyz[0] + v2.xyz[0], xyz[1] + v2.xyz[1], xyz[2] + v2.xyz[2]); }
+	V3& operator+=(const V3& v2) {
+		xyz[0] += v2.xyz[0];
+		xyz[1] += v2.xyz[1];
+		xyz[2] += v2.xyz[2];
+		return *this;
+	}
+	constexpr V3 operator-(const V3& v2) const { return V3(xyz[0] - v2.xyz[0], xyz[1] - v2.xyz[1], xyz[2] - v2.xyz[2]); }
+	V3& operator-=(const V3& v2) {
+		xyz[0] -= v2.xyz[0];
+		xyz[1] -= v2.xyz[1];
+		xyz[2] -= v2.xyz[2];
+		return *this;
+	}
 
-	bool operator==(V3 v2);
-	bool operator!=(V3 v2);
+	constexpr float operator*(const V3& v2) const { return xyz[0] * v2.xyz[0] + xyz[1] * v2.xyz[1] + xyz[2] * v2.xyz[2]; }
+	constexpr V3 operator^(const V3& v2) const {
+		return V3(xyz[1] * v2.xyz[2] - xyz[2] * v2.xyz[1],
+			xyz[2] * v2.xyz[0] - xyz[0] * v2.xyz[2],
+			xyz[0] * v2.xyz[1] - xyz[1] * v2.xyz[0]);
+	}
+	constexpr V3 operator*(float scalar) const { return V3(xyz[0] * scalar, xyz[1] * scalar, xyz[2] * scalar); }
+	V3& operator*=(float scalar) {
+		xyz[0] *= scalar;
+		xyz[1] *= scalar;
+		xyz[2] *= scalar;
+		return *this;
+	}
+	friend constexpr V3 operator*(float scalar, const V3& v) { return v * scalar; } // Scalar multiplication from left
+	constexpr V3 operator/(float scalar) const { return V3(xyz[0] / scalar, xyz[1] / scalar, xyz[2] / scalar); }
+	V3& operator/=(float scalar) {
+		xyz[0] /= scalar;
+		xyz[1] /= scalar;
+		xyz[2] /= scalar;
+		return *this;
+	}
 
-	friend ostream& operator<<(ostream& ostr, V3 v);
-	friend istream& operator>>(istream& ostr, V3& v);
+	constexpr bool operator==(const V3& v2) const { return xyz[0] == v2.xyz[0] && xyz[1] == v2.xyz[1] && xyz[2] == v2.xyz[2]; }
+	constexpr bool operator!=(const V3& v2) const { return !(*this == v2); }
 
-	float length();
-	V3 normalized();
+	friend ostream& operator<<(ostream& ostr, const V3& v) { return ostr << v[0] << " " << v[1] << " " << v[2]; }
+	friend istream& operator>>(istream& istr, V3& v) { return istr >> v[0] >> v[1] >> v[2]; }
 
-	V3 rotate_point(V3 Oa, V3 a, float rotation_degrees);
-	V3 rotate_direction(V3 a, float rotation_degrees);
+	float length() const { return sqrtf(*this * *this); }
+	V3 normalized() const {
+		float len = length();
+		if (len == 0.0f)
+			return V3();
+		return *this / len;
+	}
 
-	unsigned int convert_to_color_int();
-	void set_as_color(unsigned int color);
+	V3 rotate_point(V3 Oa, V3 a, float rotation_degrees) const; // in m33.h, they need M33
+	V3 rotate_direction(V3 a, float rotation_degrees) const;
 
-	V3 lighted(V3 n, V3 ld, V3 view_dir, float ka, int specular_exp);
-	void light(V3 n, V3 ld, V3 view_dir, float ka, int specular_exp);
+	unsigned int convert_to_color_int() const {
+#if GP_SSE
+		// One clamp and convert for all three channels, truncating like the scalar casts. min
+		// comes first with c on the left so NaN turns into 1, like fminf(1, NaN)
+		__m128 c = _mm_set_ps(0.0f, xyz[2], xyz[1], xyz[0]);
+		c = _mm_max_ps(_mm_min_ps(c, _mm_set1_ps(1.0f)), _mm_setzero_ps());
+		__m128i i = _mm_cvttps_epi32(_mm_mul_ps(c, _mm_set1_ps(255.0f)));
+		i = _mm_packs_epi32(i, i);
+		i = _mm_packus_epi16(i, i);
+		return 0xFF000000 | ((unsigned int)_mm_cvtsi128_si32(i) & 0x00FFFFFF);
+#else
+		unsigned int r = (unsigned int)(fmaxf(0.0f, fminf(1.0f, xyz[0])) * 255.0f);
+		unsigned int g = (unsigned int)(fmaxf(0.0f, fminf(1.0f, xyz[1])) * 255.0f);
+		unsigned int b = (unsigned int)(fmaxf(0.0f, fminf(1.0f, xyz[2])) * 255.0f);
+		return 0xFF000000 + (b << 16) + (g << 8) + r;
+#endif
+	}
+	void set_as_color(unsigned int color) {
+		xyz[0] = (float)(color & 0x000000FF) / 255.0f;
+		xyz[1] = (float)((color & 0x0000FF00) >> 8) / 255.0f;
+		xyz[2] = (float)((color & 0x00FF0000) >> 16) / 255.0f;
+	}
 
-	V3 reflected(V3 l);
+	V3 lighted(V3 n, V3 ld, V3 view_dir, float ka, int specular_exp) const {
+		//n should already be normal
+		ld = ld.normalized();
+		view_dir = view_dir.normalized();
+
+		float kd = n * ld;
+		kd = fmaxf(0.0f, kd);
+
+		float ks = fmaxf(0.0f, powf(fmaxf(0.0f, n.reflected(ld) * view_dir), (float)specular_exp));
+		return *this * (ka + (1.0f - ka) * kd + ks);
+	}
+	void light(V3 n, V3 ld, V3 view_dir, float ka, int specular_exp) {
+		*this = lighted(n, ld, view_dir, ka, specular_exp);
+	}
+
+	constexpr V3 reflected(const V3& l) const {
+		return 2.0f * (*this * (*this * l)) - l;
+	}
 };
+
+#include "m33.h"
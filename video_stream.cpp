@@ -0,0 +1,208 @@
+#include "video_stream.h"
+#include "image.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <emmintrin.h>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+using namespace std;
+
+// Fixed point BT.601 studio range with 8 fractional bits, the SSE2 path below computes the same
+static inline unsigned char rgb_to_y(int r, int g, int b) {
+	return (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+static inline unsigned char rgb_to_u(int r, int g, int b) {
+	return (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+static inline unsigned char rgb_to_v(int r, int g, int b) {
+	return (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+//Splits 8 RGBA8 pixels into 16 bit R, G and B lanes
+static inline void load_rgb8(const unsigned int* src, __m128i& r, __m128i& g, __m128i& b) {
+	__m128i p0 = _mm_loadu_si128((const __m128i*)src);
+	__m128i p1 = _mm_loadu_si128((const __m128i*)(src + 4));
+	__m128i mask = _mm_set1_epi32(0xFF);
+	r = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+	g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask), _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+	b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask), _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+}
+
+//Sums stay below 2^16, so unsigned wraparound in the 16 bit lanes is harmless
+static inline __m128i luma8(__m128i r, __m128i g, __m128i b) {
+	__m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)), _mm_mullo_epi16(g, _mm_set1_epi16(129))),
+		_mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(25)), _mm_set1_epi16(128)));
+	return _mm_add_epi16(_mm_srli_epi16(sum, 8), _mm_set1_epi16(16));
+}
+
+static inline __m128i chroma8(__m128i r, __m128i g, __m128i b, short kr, short kg, short kb) {
+	__m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(kr)), _mm_mullo_epi16(g, _mm_set1_epi16(kg))),
+		_mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(kb)), _mm_set1_epi16(128)));
+	return _mm_add_epi16(_mm_srai_epi16(sum, 8), _mm_set1_epi16(128));
+}
+
+//Rounded average of each 2x2 block of two rows of 8 lanes, 4 results in the low lanes
+static inline __m128i average_2x2(__m128i row0, __m128i row1) {
+	__m128i sums = _mm_madd_epi16(_mm_add_epi16(row0, row1), _mm_set1_epi16(1));
+	__m128i avg = _mm_srli_epi32(_mm_add_epi32(sums, _mm_set1_epi32(2)), 2);
+	return _mm_packs_epi32(avg, _mm_setzero_si128());
+}
+
+void rgba_to_yuv420(const unsigned int* pix, int w, int h, int row_begin, int row_end,
+	unsigned char* y_plane, unsigned char* u_plane, unsigned char* v_plane) {
+	int cw = (w + 1) / 2;
+	int w8 = w & ~7;
+
+	for (int y = row_begin; y < row_end; y += 2) {
+		bool has_row1 = y + 1 < h;
+		// pix is bottom row first, the planes top row first
+		const unsigned int* src0 = pix + (size_t)(h - 1 - y) * w;
+		const unsigned int* src1 = has_row1 ? src0 - w : src0;
+		unsigned char* dst0 = y_plane + (size_t)y * w;
+		unsigned char* dst1 = dst0 + w;
+		unsigned char* du = u_plane + (size_t)(y / 2) * cw;
+		unsigned char* dv = v_plane + (size_t)(y / 2) * cw;
+
+		for (int x = 0; x < w8; x += 8) {
+			__m128i r0, g0, b0, r1, g1, b1;
+			load_rgb8(src0 + x, r0, g0, b0);
+			load_rgb8(src1 + x, r1, g1, b1);
+
+			_mm_storel_epi64((__m128i*)(dst0 + x), _mm_packus_epi16(luma8(r0, g0, b0), _mm_setzero_si128()));
+			if (has_row1)
+				_mm_storel_epi64((__m128i*)(dst1 + x), _mm_packus_epi16(luma8(r1, g1, b1), _mm_setzero_si128()));
+
+			__m128i r = average_2x2(r0, r1);
+			__m128i g = average_2x2(g0, g1);
+			__m128i b = average_2x2(b0, b1);
+			int u4 = _mm_cvtsi128_si32(_mm_packus_epi16(chroma8(r, g, b, -38, -74, 112), _mm_setzero_si128()));
+			int v4 = _mm_cvtsi128_si32(_mm_packus_epi16(chroma8(r, g, b, 112, -94, -18), _mm_setzero_si128()));
+			memcpy(du + x / 2, &u4, 4);
+			memcpy(dv + x / 2, &v4, 4);
+		}
+
+		// Columns past the last multiple of 8, an odd last column is paired with itself
+		const unsigned int* srcs[2] = { src0, src1 };
+		unsigned char* dsts[2] = { dst0, dst1 };
+		for (int x = w8; x < w; x += 2) {
+			int xs[2] = { x, min(x + 1, w - 1) };
+			int rs = 0, gs = 0, bs = 0;
+			for (int ri = 0; ri < 2; ri++) {
+				for (int xi : xs) {
+					unsigned int p = srcs[ri][xi];
+					int r = p & 0xFF, g = (p >> 8) & 0xFF, b = (p >> 16) & 0xFF;
+					rs += r;
+					gs += g;
+					bs += b;
+					if (ri == 0 || has_row1)
+						dsts[ri][xi] = rgb_to_y(r, g, b);
+				}
+			}
+			rs = (rs + 2) >> 2;
+			gs = (gs + 2) >> 2;
+			bs = (bs + 2) >> 2;
+			du[x / 2] = rgb_to_u(rs, gs, bs);
+			dv[x / 2] = rgb_to_v(rs, gs, bs);
+		}
+	}
+}
+
+VideoStream::VideoStream() {
+	out = nullptr;
+	is_stdout = false;
+	format = video_format::RAW_RGBA;
+	w = 0;
+	h = 0;
+}
+
+VideoStream::~VideoStream() {
+	close();
+}
+
+bool VideoStream::open(const string& fname, video_format _format, int _w, int _h, int fps) {
+	close();
+	format = _format;
+	w = _w;
+	h = _h;
+
+	if (fname == "-") {
+#ifdef _WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		out = stdout;
+		is_stdout = true;
+	}
+	else {
+		out = fopen(fname.c_str(), "wb");
+		is_stdout = false;
+		if (!out) {
+			cerr << "ERROR: cannot open " << fname << " for writing" << endl;
+			return false;
+		}
+	}
+
+	if (format == video_format::Y4M) {
+		// C420jpeg sites chroma in the middle of each 2x2 block, which is what averaging gives
+		fprintf(out, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", w, h, fps);
+		frame.resize((size_t)w * h + 2 * (size_t)((w + 1) / 2) * ((h + 1) / 2));
+	}
+	return true;
+}
+
+void VideoStream::convert_to_yuv420(const unsigned int* pix) {
+	int cw = (w + 1) / 2;
+	int ch = (h + 1) / 2;
+	unsigned char* y_plane = frame.data();
+	unsigned char* u_plane = y_plane + (size_t)w * h;
+	unsigned char* v_plane = u_plane + (size_t)cw * ch;
+
+	// Row pairs are independent
+	thread_pool()->parallel_for(ch, 16, [=](int begin, int end) {
+		rgba_to_yuv420(pix, w, h, begin * 2, min(h, end * 2), y_plane, u_plane, v_plane);
+	});
+}
+
+bool VideoStream::write(Image* image) {
+	TraceScope trace("VideoStream::write");
+	if (!out)
+		return false;
+	if (image->w != w || image->h != h) {
+		cerr << "ERROR: frame is " << image->w << "x" << image->h << ", stream is " << w << "x" << h << endl;
+		return false;
+	}
+
+	bool ok = true;
+	if (format == video_format::Y4M) {
+		convert_to_yuv420(image->pix);
+		ok = fputs("FRAME\n", out) >= 0 && fwrite(frame.data(), 1, frame.size(), out) == frame.size();
+	}
+	else {
+		for (int row = h - 1; row >= 0 && ok; row--) {
+			ok = fwrite(image->pix + (size_t)row * w, sizeof(unsigned int), w, out) == (size_t)w;
+		}
+	}
+
+	if (!ok)
+		cerr << "ERROR: failed writing a frame to the video stream" << endl;
+	return ok;
+}
+
+void VideoStream::close() {
+	if (!out)
+		return;
+	if (is_stdout)
+		fflush(out);
+	else
+		fclose(out);
+	out = nullptr;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+class Image;
+
+enum class video_format {
+	RAW_RGBA, // RGBA8 frames back to back, top row first, no header
+	Y4M // YUV4MPEG2 4:2:0, BT.601 studio range, readable by ffmpeg and most encoders
+};
+
+// Streams a rendered sequence into one file or a pipe, "-" is stdout. The file is opened
+// once for the whole sequence, so piping into an encoder costs no per-frame file creation.
+class VideoStream {
+public:
+	VideoStream();
+	~VideoStream(); // closes the file unless it is stdout
+
+	bool open(const std::string& fname, video_format _format, int _w, int _h, int fps = 30);
+	bool write(Image* image); // image has to be w by h
+	void close();
+
+	bool is_open() { return out != nullptr; }
+
+private:
+	FILE* out;
+	bool is_stdout;
+	video_format format;
+	int w, h;
+	std::vector<unsigned char> frame; // one converted frame
+
+	void convert_to_yuv420(const unsigned int* pix);
+};
+
+// BT.601 studio range conversion of the rows [row_begin, row_end) of a bottom row first
+// RGBA8 image to top row first planes, row_begin and row_end even. Chroma is the average of
+// each 2x2 block. u_plane and v_plane are (w + 1) / 2 wide.
+void rgba_to_yuv420(const unsigned int* pix, int w, int h, int row_begin, int row_end,
+	unsigned char* y_plane, unsigned char* u_plane, unsigned char* v_plane);